@@ -0,0 +1,387 @@
+/*
+	benchmark suite for the solvers of Ex1SerialParallelConjugate.cpp, a separate
+	executable built from the same source:
+
+		mpicxx -O2 -std=c++17 -fopenmp Ex1ConjugateBenchmark.cpp -o cg_bench
+		mpirun -np 4 ./cg_bench --sizes=64,128,256 --threads=1,2,4
+
+	every suite runs on the nx x nx Poisson problem for each of --sizes and each of
+	--threads (OpenMP threads per rank):
+	spmv     one stencil and one CSR product, on the master
+	cg       serial CG (cg_solve on the stencil), on the master
+	pcg      serial PCG with each of --precond, on the master
+	master   the master/worker solver over all ranks (needs two or more); its
+	         protocol spans MPI_COMM_WORLD, so only --threads is swept, not --ranks
+	strong   distributed CG on the first p ranks for each p of --ranks, same grid
+	weak     distributed CG on an nx x (p * nx) grid, the same block per rank
+	converge every distributed CG variant on all ranks, on grids of at least
+	         CONVERGE_MIN_GRID a side (smaller --sizes run once at that side, with
+	         one thread): fails (exit status 1) unless the recurrence
+	         and the true residual b - A x both reach tol (the latter within
+	         CONVERGE_TRUE_SLACK, the attainable accuracy)
+	--suites=a,b picks some of them, all by default.
+
+	one CSV row per run on stdout: the time per iteration, GFLOP/s (the SpMV and
+	the CG vector work, not the preconditioner), the effective bandwidth of the SpMV
+	rows (matrix, x and y each moved once) and the parallel efficiency against the
+	first thread / rank count of the same size. a time is the median of --repeat
+	runs after one warm-up, for the MPI suites the slowest rank's. b is drawn with
+	--seed, so every run and every rank count solves the same system
+*/
+#define CG_NO_MAIN
+#include "Ex1SerialParallelConjugate.cpp"
+#undef CG_NO_MAIN
+
+typedef double Real;
+
+struct BenchOptions {
+	vector < int > sizes = { 64, 128, 256 };
+	vector < int > threads = { 1 };
+	vector < int > ranks;
+	vector < string > preconds = { "jacobi", "ic0", "mg" };
+	vector < string > suites = { "spmv", "cg", "pcg", "master", "strong", "weak", "converge" };
+	int repeat = 3;
+	unsigned seed = RHS_SEED;
+	long double tol = EPS;
+
+	bool runs(const string& suite) const {
+		return std::find(suites.begin(), suites.end(), suite) != suites.end();
+	}
+};
+
+/* "a,b,c" split at the commas */
+vector < string > split_list(const string& list) {
+	vector < string > ret;
+	size_t at = 0;
+	while (at <= list.size()) {
+		size_t comma = list.find(',', at);
+		if (comma == string::npos) comma = list.size();
+		if (comma > at) ret.push_back(list.substr(at, comma - at));
+		at = comma + 1;
+	}
+	return ret;
+}
+
+vector < int > split_ints(const string& list) {
+	vector < int > ret;
+	for (const string& s : split_list(list)) {
+		if (atoi(s.c_str()) > 0) ret.push_back(atoi(s.c_str()));
+	}
+	return ret;
+}
+
+/* 1, 2, 4, ... up to size, and size itself */
+vector < int > default_ranks(int size) {
+	vector < int > ret;
+	for (int p = 1; p < size; p *= 2) ret.push_back(p);
+	ret.push_back(size);
+	return ret;
+}
+
+void use_threads(int threads) {
+	if (threads > 1) set_backend(BACKEND_THREADS, threads);
+	else set_backend(BACKEND_SERIAL);
+}
+
+struct Sample {
+	int itr = 0;
+	double seconds = 0;
+};
+
+/*
+	runs fn (returning its iteration count) once to warm up and then repeat times;
+	every run is timed between barriers on comm and counts as the slowest rank's
+	time. returns the median run
+*/
+template <class Fn>
+Sample measure(int repeat, MPI_Comm comm, Fn fn) {
+	fn();
+	vector < double > times;
+	Sample ret;
+	for (int k = 0; k < max(1, repeat); ++k) {
+		MPI_Barrier(comm);
+		double begin = MPI_Wtime();
+		ret.itr = fn();
+		double local = MPI_Wtime() - begin, slowest;
+		MPI_Allreduce(&local, &slowest, 1, MPI_DOUBLE, MPI_MAX, comm);
+		times.push_back(slowest);
+	}
+	std::sort(times.begin(), times.end());
+	ret.seconds = times[times.size() / 2];
+	return ret;
+}
+
+/* seconds per call of fn, averaged over enough calls to take a measurable time */
+template <class Fn>
+double time_per_call(Fn fn) {
+	const double least = 0.05;
+	int calls = 0;
+	double begin = MPI_Wtime(), elapsed;
+	do {
+		fn();
+		++calls;
+		elapsed = MPI_Wtime() - begin;
+	} while (elapsed < least || calls < 5);
+	return elapsed / calls;
+}
+
+/* median of repeat time_per_call measurements after a warm-up call */
+template <class Fn>
+double median_per_call(int repeat, Fn fn) {
+	fn();
+	vector < double > times;
+	for (int k = 0; k < max(1, repeat); ++k) times.push_back(time_per_call(fn));
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+/* nonzeros of the 5-point stencil on an nx x ny grid */
+double stencil_nnz(int nx, int ny) {
+	return 5.0 * nx * ny - 2.0 * nx - 2.0 * ny;
+}
+
+/* one SpMV, 2 dots, 3 axpy-like updates per CG iteration; PCG has a third dot */
+double cg_flops(int nx, int ny, bool preconditioned = false) {
+	double n = (double)nx * ny;
+	return 2 * stencil_nnz(nx, ny) + (preconditioned ? 12 : 10) * n;
+}
+
+void print_header(const BenchOptions& opt, int size) {
+	cout << "# cg benchmark: " << size << " ranks, seed " << opt.seed << ", tol " << (double)opt.tol
+		<< ", median of " << opt.repeat << ", " << sizeof(Real) << "-byte scalars" << endl;
+	cout << "suite,solver,nx,ny,ranks,threads,iterations,seconds,sec_per_iter,gflops,gbs,efficiency" << endl;
+}
+
+/* gbs and efficiency are left empty when negative */
+void print_row(const string& suite, const string& solver, int nx, int ny, int ranks, int threads,
+	const Sample& s, double flops_per_iter, double gbs = -1, double efficiency = -1) {
+	int itr = max(1, s.itr);
+	double per_iter = s.seconds / itr;
+	printf("%s,%s,%d,%d,%d,%d,%d,%.6g,%.6g,%.4g,", suite.c_str(), solver.c_str(), nx, ny, ranks, threads,
+		s.itr, s.seconds, per_iter, flops_per_iter / per_iter * 1e-9);
+	if (gbs >= 0) printf("%.4g", gbs);
+	printf(",");
+	if (efficiency >= 0) printf("%.3f", efficiency);
+	printf("\n");
+	fflush(stdout);
+}
+
+/* efficiency of per_iter seconds on cores cores against the first run of the sweep */
+struct Scaling {
+	double base = -1;
+	int base_cores = 1;
+
+	double efficiency(double per_iter, int cores, bool weak) {
+		if (base < 0) base = per_iter, base_cores = cores;
+		return weak ? base / per_iter : base * base_cores / (per_iter * cores);
+	}
+};
+
+void bench_spmv(const BenchOptions& opt) {
+	for (int nx : opt.sizes) {
+		PoissonStencil < Real > S(nx, nx);
+		Matrix_csr < Real > C = to_csr(S);
+		Matrix < Real > x(S.getRowSize(), 1), y(S.getRowSize(), 1);
+		fill_random(x, opt.seed);
+		double n = (double)nx * nx, nnz = stencil_nnz(nx, nx);
+		double stencil_bytes = 2 * n * sizeof(Real);
+		double csr_bytes = nnz * (sizeof(Real) + sizeof(int)) + (n + 1) * sizeof(int) + 2 * n * sizeof(Real);
+		Scaling stencil_scaling, csr_scaling;
+		for (int t : opt.threads) {
+			use_threads(t);
+			Sample s;
+			s.itr = 1;
+			s.seconds = median_per_call(opt.repeat, [&]() { multiply(S, x, y); });
+			print_row("spmv", "stencil", nx, nx, 1, t, s, 2 * nnz, stencil_bytes / s.seconds * 1e-9, stencil_scaling.efficiency(s.seconds, t, false));
+			s.seconds = median_per_call(opt.repeat, [&]() { multiply(C, x, y); });
+			print_row("spmv", "csr", nx, nx, 1, t, s, 2 * nnz, csr_bytes / s.seconds * 1e-9, csr_scaling.efficiency(s.seconds, t, false));
+		}
+	}
+	use_threads(1);
+}
+
+void bench_serial(const BenchOptions& opt, bool cg, bool pcg) {
+	for (int nx : opt.sizes) {
+		auto t = generate_sparse_matrix<Real>(nx, nx, opt.seed);
+		Matrix_csr < Real > A = to_csr(t.second);
+		Matrix < Real > X(t.first.getRowSize(), 1);
+		Scaling cg_scaling;
+		for (int threads : opt.threads) {
+			use_threads(threads);
+			if (cg) {
+				Sample s = measure(opt.repeat, MPI_COMM_SELF, [&]() {
+					std::fill(X.data(), X.data() + X.size(), Real(0));
+					return cg_solve(t.second, t.first, X, opt.tol);
+				});
+				print_row("cg", "cg", nx, nx, 1, threads, s, cg_flops(nx, nx), -1, cg_scaling.efficiency(s.seconds / max(1, s.itr), threads, false));
+			}
+			if (!pcg) continue;
+			for (const string& name : opt.preconds) {
+				auto solve = [&](auto& M) {
+					Sample s = measure(opt.repeat, MPI_COMM_SELF, [&]() {
+						Real rr;
+						std::fill(X.data(), X.data() + X.size(), Real(0));
+						return pcg_solve(M, t.second, t.first, X, rr, opt.tol);
+					});
+					print_row("pcg", "pcg-" + name, nx, nx, 1, threads, s, cg_flops(nx, nx, true));
+				};
+				if (!with_preconditioner(name, t.second, A, solve)) cout << "# unknown preconditioner: " << name << endl;
+			}
+		}
+	}
+	use_threads(1);
+}
+
+/*
+	the master times master_cg_solve while the workers serve it from run_worker,
+	one worker session per thread count with every rank on that many threads
+*/
+void bench_master(const BenchOptions& opt, int rank, int size) {
+	if (size < 2) {
+		if (rank == MASTER) cout << "# master: needs at least one worker, skipped" << endl;
+		return;
+	}
+	vector < Scaling > scaling(opt.sizes.size());
+	for (int threads : opt.threads) {
+		use_threads(threads);
+		if (rank != MASTER) {
+			run_worker<Real>(rank, size);
+			continue;
+		}
+		for (size_t i = 0; i < opt.sizes.size(); ++i) {
+			int nx = opt.sizes[i];
+			auto t = generate_sparse_matrix<Real>(nx, nx, opt.seed);
+			Matrix < Real > X(t.first.getRowSize(), 1);
+			Sample s = measure(opt.repeat, MPI_COMM_SELF, [&]() {
+				Real rr;
+				return master_cg_solve(t.second, t.first, X, rr, size, opt.tol);
+			});
+			print_row("master", "cg", nx, nx, size, threads, s, cg_flops(nx, nx), -1, scaling[i].efficiency(s.seconds / max(1, s.itr), threads, false));
+		}
+		shutdown_workers();
+	}
+	use_threads(1);
+}
+
+/*
+	distributed CG on the first p ranks for every p of --ranks: on an nx x nx grid
+	(strong scaling) or on nx x (p * nx) (weak scaling). every rank of the run
+	generates b from the seed and keeps its own block
+*/
+void bench_distributed(const BenchOptions& opt, int rank, bool weak) {
+	for (int nx : opt.sizes) {
+		Scaling scaling;
+		for (int p : opt.ranks) {
+			int ny = weak ? p * nx : nx;
+			MPI_Comm comm;
+			MPI_Comm_split(MPI_COMM_WORLD, rank < p ? 0 : MPI_UNDEFINED, rank, &comm);
+			if (comm == MPI_COMM_NULL) continue;
+			auto t = generate_sparse_matrix<Real>(nx, ny, opt.seed);
+			DistributedPoisson < Real > A(t.second, comm);
+			Matrix < Real > b(A.local_size(), 1), X(A.local_size(), 1);
+			for (int i = A.row_begin, k = 0; i < A.row_end; ++i) {
+				for (int j = A.col_begin; j < A.col_end; ++j) b[k++] = t.first[map_to_int(i, j, nx, ny)];
+			}
+			for (int threads : opt.threads) {
+				use_threads(threads);
+				Sample s = measure(opt.repeat, comm, [&]() {
+					Real rr;
+					std::fill(X.data(), X.data() + X.size(), Real(0));
+					return distributed_conjugate_gradient(A, b, X, rr, opt.tol);
+				});
+				double e = scaling.efficiency(s.seconds / max(1, s.itr), p * threads, weak);
+				if (rank == MASTER) print_row(weak ? "weak" : "strong", "cg", nx, ny, p, threads, s, cg_flops(nx, ny), -1, e);
+			}
+			MPI_Comm_free(&comm);
+		}
+	}
+	use_threads(1);
+}
+
+const int CONVERGE_MIN_GRID = 100;
+const double CONVERGE_TRUE_SLACK = 100;
+
+/* returns false when a variant stops short of tol */
+bool bench_converge(const BenchOptions& opt, int rank, int size) {
+	const char* const names[] = { "cg", "pipelined", "sstep" };
+	bool all = true;
+	vector < int > sides;
+	for (int side : opt.sizes) {
+		int nx = max(side, CONVERGE_MIN_GRID);
+		if (std::find(sides.begin(), sides.end(), nx) == sides.end()) sides.push_back(nx);
+	}
+	for (int nx : sides) {
+		auto t = generate_sparse_matrix<Real>(nx, nx, opt.seed);
+		DistributedPoisson < Real > A(t.second, MPI_COMM_WORLD);
+		Matrix < Real > b(A.local_size(), 1), X(A.local_size(), 1), AX(A.local_size(), 1);
+		for (int i = A.row_begin, k = 0; i < A.row_end; ++i) {
+			for (int j = A.col_begin; j < A.col_end; ++j) b[k++] = t.first[map_to_int(i, j, nx, nx)];
+		}
+		Real bb = A.dot(b, b);
+		for (CgAlgorithm algorithm : { CG_CLASSIC, CG_PIPELINED, CG_SSTEP }) {
+			Real rr = 0;
+			Sample s = measure(opt.repeat, MPI_COMM_WORLD, [&]() {
+				std::fill(X.data(), X.data() + X.size(), Real(0));
+				return distributed_solve(algorithm, A, b, X, rr, opt.tol);
+			});
+			A.apply(X, AX);
+			for (int i = 0; i < A.local_size(); ++i) AX[i] = b[i] - AX[i];
+			double recurrence = sqrt(rr / bb), true_residual = sqrt(A.dot(AX, AX) / bb);
+			bool ok = recurrence < opt.tol && true_residual < CONVERGE_TRUE_SLACK * opt.tol;
+			all = all && ok;
+			if (rank != MASTER) continue;
+			print_row("converge", names[algorithm], nx, nx, size, 1, s, cg_flops(nx, nx));
+			if (!ok) {
+				cout << "# converge: " << names[algorithm] << " on " << nx << " x " << nx << " stopped at ||r|| / ||b|| = "
+					<< recurrence << " (true " << true_residual << "), tol " << (double)opt.tol << endl;
+			}
+		}
+	}
+	return all;
+}
+
+int main(int argc, char* argv[]) {
+	int rank, size, provided;
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+	/*
+		--sizes=64,128 grid sides, --threads=1,2,4 threads per rank, --ranks=1,2,4
+		rank counts of strong/weak (default powers of two and the world size),
+		--precond=jacobi,mg preconditioners of pcg, --suites=spmv,cg,... suites to run,
+		--repeat=N timed runs per row, --seed=N seed of b, --tol=x solver tolerance
+	*/
+	BenchOptions opt;
+	opt.ranks = default_ranks(size);
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg.compare(0, 8, "--sizes=") == 0) opt.sizes = split_ints(arg.substr(8));
+		if (arg.compare(0, 10, "--threads=") == 0) opt.threads = split_ints(arg.substr(10));
+		if (arg.compare(0, 8, "--ranks=") == 0) opt.ranks = split_ints(arg.substr(8));
+		if (arg.compare(0, 10, "--precond=") == 0) opt.preconds = split_list(arg.substr(10));
+		if (arg.compare(0, 9, "--suites=") == 0) opt.suites = split_list(arg.substr(9));
+		if (arg.compare(0, 9, "--repeat=") == 0) opt.repeat = atoi(arg.c_str() + 9);
+		if (arg.compare(0, 7, "--seed=") == 0) opt.seed = (unsigned)strtoul(arg.c_str() + 7, NULL, 10);
+		if (arg.compare(0, 6, "--tol=") == 0) opt.tol = strtold(arg.c_str() + 6, NULL);
+	}
+	opt.ranks.erase(std::remove_if(opt.ranks.begin(), opt.ranks.end(), [&](int p) { return p > size; }), opt.ranks.end());
+	if (provided < MPI_THREAD_FUNNELED && opt.threads != vector < int >{ 1 }) {
+		if (rank == MASTER) cout << "# MPI library without MPI_THREAD_FUNNELED, running single-threaded" << endl;
+		opt.threads = { 1 };
+	}
+
+	if (rank == MASTER) {
+		print_header(opt, size);
+		if (opt.runs("spmv")) bench_spmv(opt);
+		if (opt.runs("cg") || opt.runs("pcg")) bench_serial(opt, opt.runs("cg"), opt.runs("pcg"));
+	}
+	MPI_Barrier(MPI_COMM_WORLD);
+	if (opt.runs("master")) bench_master(opt, rank, size);
+	if (opt.runs("strong")) bench_distributed(opt, rank, false);
+	if (opt.runs("weak")) bench_distributed(opt, rank, true);
+	bool converged = !opt.runs("converge") || bench_converge(opt, rank, size);
+
+	MPI_Finalize();
+	return converged ? 0 : 1;
+}
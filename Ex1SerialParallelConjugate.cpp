@@ -6,47 +6,667 @@
 #include <algorithm>
 #include <cassert>
 #include <vector>
+#include <string>
+#include <new>
+#include <type_traits>
+#include <climits>
+#include <limits>
+#include <cstring>
+#include <cstdint>
+#include <random>
+#include <numeric>
+#include <queue>
+#include <deque>
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+/* OpenMP directive that disappears, warning-free, in a build without -fopenmp */
+#ifdef _OPENMP
+#define OMP(directive) _Pragma(#directive)
+#else
+#define OMP(directive)
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
 #define MASTER 0
 
+/* default convergence test ||r|| / ||b|| < EPS of the solvers */
 const long double EPS = 1e-10;
-const int dim_mx = 20;
 const int val_mx = 1000000;
 
+/*
+	cap on the iterations of every CG loop, changed at run time with
+	set_iteration_limit(); a solver that reaches it returns with tol unmet
+*/
+int iteration_limit = INT_MAX;
+
+void set_iteration_limit(int limit) {
+	iteration_limit = limit > 0 ? limit : INT_MAX;
+}
+/*
+	right-hand sides come from an mt19937 with a fixed seed instead of rand(): its
+	sequence is fixed by the standard, so every build and platform solves the same b
+*/
+const unsigned RHS_SEED = 1;
+
+/*
+	execution backend of the shared-memory kernels (vector ops, SpMV, stencil)
+	BACKEND_SERIAL runs every loop on the calling thread, BACKEND_THREADS spreads
+	them over the OpenMP team. chosen at run time with set_backend(); built
+	without -fopenmp the OMP() directives expand to nothing and both backends run serially
+*/
+enum Backend { BACKEND_SERIAL, BACKEND_THREADS };
+Backend kernel_backend = BACKEND_SERIAL;
+
+/* loops shorter than this stay on one thread, forking would cost more than the work */
+const size_t PARALLEL_MIN = 4096;
+/* reduction block: partial sums are taken per block, never per thread */
+const size_t REDUCE_BLOCK = 2048;
+
+void set_backend(Backend b, int threads = 0) {
+	kernel_backend = b;
+#ifdef _OPENMP
+	if (threads > 0) omp_set_num_threads(threads);
+#else
+	(void)threads;
+#endif
+}
+
+inline bool run_parallel(const size_t work) {
+	return kernel_backend == BACKEND_THREADS && work >= PARALLEL_MIN;
+}
+
+/*
+	solver instrumentation, off until set_stats() gets a report path. wall-clock time
+	(MPI_Wtime, so time blocked in MPI counts) is split into exclusive phases: a
+	PhaseTimer charges its phase from construction to destruction and pauses the
+	enclosing timer meanwhile, so e.g. the SpMVs inside a preconditioner apply are
+	counted once, as spmv, and the phases never add up to more than the solve.
+	"axpy" covers all local vector kernels (axpy, xpay, local dot products), "wait"
+	the time spent completing non-blocking communication. the communication
+	helpers add what they send, the solvers the relative residual of every iteration
+	(of the innermost solve for the nested mixed precision solvers).
+	disabled, every hook is one branch
+*/
+enum Phase { PHASE_SPMV, PHASE_REDUCE, PHASE_AXPY, PHASE_WAIT, PHASE_PRECOND, PHASE_COUNT };
+const char* const phase_names[PHASE_COUNT] = { "spmv", "reduce", "axpy", "wait", "precond" };
+
+struct SolverStats {
+	bool enabled = false;
+	string report_path;
+	double seconds[PHASE_COUNT];
+	long long calls[PHASE_COUNT];
+	long long bytes_sent, messages_sent;
+	vector < double > residuals;
+	/* running phase (PHASE_COUNT for none) and when it was last charged */
+	int current;
+	double since;
+
+	SolverStats() { reset(); }
+
+	void reset() {
+		std::fill(seconds, seconds + PHASE_COUNT, 0.0);
+		std::fill(calls, calls + PHASE_COUNT, 0);
+		bytes_sent = messages_sent = 0;
+		residuals.clear();
+		current = PHASE_COUNT;
+	}
+};
+SolverStats solver_stats;
+
+/* collects from now on and writes the report of the next solve to path (.csv or JSON), "" turns it off */
+void set_stats(const string& path) {
+	solver_stats.enabled = !path.empty();
+	solver_stats.report_path = path;
+	solver_stats.reset();
+}
+
+class PhaseTimer {
+public:
+	explicit PhaseTimer(Phase p) {
+		SolverStats& s = solver_stats;
+		if (!s.enabled) return;
+		active = true;
+		double now = MPI_Wtime();
+		if (s.current != PHASE_COUNT) s.seconds[s.current] += now - s.since;
+		parent = s.current, s.current = p, s.since = now;
+		s.calls[p]++;
+	}
+	~PhaseTimer() {
+		SolverStats& s = solver_stats;
+		if (!active) return;
+		double now = MPI_Wtime();
+		s.seconds[s.current] += now - s.since;
+		s.current = parent, s.since = now;
+	}
+	PhaseTimer(const PhaseTimer&) = delete;
+	PhaseTimer& operator = (const PhaseTimer&) = delete;
+
+private:
+	bool active = false;
+	int parent = PHASE_COUNT;
+};
+
+inline void count_sent(long long bytes, long long messages = 1) {
+	if (!solver_stats.enabled) return;
+	solver_stats.bytes_sent += bytes;
+	solver_stats.messages_sent += messages;
+}
+
+inline void record_residual(long double relative) {
+	if (solver_stats.enabled) solver_stats.residuals.push_back((double)relative);
+}
+
+/* silences the hooks for its lifetime, for checks that are not part of the measured solve */
+class StatsPause {
+public:
+	StatsPause() : was(solver_stats.enabled) { solver_stats.enabled = false; }
+	~StatsPause() { solver_stats.enabled = was; }
+	StatsPause(const StatsPause&) = delete;
+	StatsPause& operator = (const StatsPause&) = delete;
+
+private:
+	bool was;
+};
+
+/*
+	the solvers stop on their recurrence residual, which in finite precision drifts
+	away from the true one: a float solve can "converge" with ||b - A x|| / ||b||
+	orders of magnitude above tol. the drivers recompute b - A x and call this
+*/
+void report_convergence(long double relative, long double tol) {
+	if (!(relative < tol)) cout << "Not converged: ||b - Ax|| / ||b|| = " << (double)relative << ", tol " << (double)tol << endl;
+}
+
+/*
+	deterministic parallel sum: [0, n) is cut into fixed REDUCE_BLOCK blocks,
+	partial(begin, end) sums one block and the block sums are added in order,
+	so serial and threaded runs give bit-identical results for any thread count
+*/
+template <class T, class F>
+T blocked_sum(const size_t n, F partial) {
+	size_t blocks = (n + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+	static thread_local vector < T > sums;
+	if (sums.size() < blocks) sums.resize(blocks);
+	T* s = sums.data();
+	OMP(omp parallel for if(run_parallel(n)) schedule(static))
+	for (size_t b = 0; b < blocks; ++b) {
+		s[b] = partial(b * REDUCE_BLOCK, min(n, (b + 1) * REDUCE_BLOCK));
+	}
+	T ret = 0;
+	for (size_t b = 0; b < blocks; ++b) ret += s[b];
+	return ret;
+}
+
+/* runs body(begin, end) over the same fixed REDUCE_BLOCK blocks as blocked_sum */
+template <class F>
+void blocked_for(const size_t n, F body) {
+	size_t blocks = (n + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+	OMP(omp parallel for if(run_parallel(n)) schedule(static))
+	for (size_t b = 0; b < blocks; ++b) {
+		body(b * REDUCE_BLOCK, min(n, (b + 1) * REDUCE_BLOCK));
+	}
+}
+
+/*
+	SIMD level of the raw-pointer kernels below, detected once from the CPU
+	float and double run AVX-512 or AVX2+FMA code when the CPU has it, every other
+	type (and every other CPU or compiler) runs the portable loops.
+	set_simd() can only lower the level, never raise it past what the CPU supports.
+	the lanes change the summation order of the reductions, so results are
+	reproducible for a fixed level but not bit-identical across levels
+*/
+enum SimdLevel { SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512 };
+
+SimdLevel detect_simd() {
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return SIMD_AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SIMD_AVX2;
+#endif
+	return SIMD_SCALAR;
+}
+
+const SimdLevel simd_supported = detect_simd();
+SimdLevel simd_level = simd_supported;
+
+void set_simd(SimdLevel l) {
+	simd_level = min(l, simd_supported);
+}
+
+template <class T>
+struct simd_type { static const bool value = false; };
+template <>
+struct simd_type<float> { static const bool value = true; };
+template <>
+struct simd_type<double> { static const bool value = true; };
+
+/* portable kernels, also the tails of the vector kernels */
+template <class T>
+T dot_scalar(const T* a, const T* b, const size_t n) {
+	T ret = 0;
+	for (size_t i = 0; i < n; ++i) ret += a[i] * b[i];
+	return ret;
+}
+template <class T>
+void axpy_scalar(T* y, const T a, const T* x, const size_t n) {
+	for (size_t i = 0; i < n; ++i) y[i] += a * x[i];
+}
+template <class T>
+void xpay_scalar(T* y, const T a, const T* x, const size_t n) {
+	for (size_t i = 0; i < n; ++i) y[i] = x[i] + a * y[i];
+}
+template <class T>
+T axpy_dot_scalar(T* y, const T a, const T* x, const size_t n) {
+	T ret = 0;
+	for (size_t i = 0; i < n; ++i) {
+		y[i] += a * x[i];
+		ret += y[i] * y[i];
+	}
+	return ret;
+}
+/*
+	one grid row of the 5-point stencil: y[j] = c * mid[j] + o * (up[j] + down[j] + mid[j - 1] + mid[j + 1])
+	mid[-1] and mid[n] must be readable
+*/
+template <class T>
+void stencil_row_scalar(const T* up, const T* mid, const T* down, const T c, const T o, T* y, const size_t n) {
+	for (size_t j = 0; j < n; ++j) {
+		y[j] = c * mid[j] + o * (up[j] + down[j] + mid[j - 1] + mid[j + 1]);
+	}
+}
+
+#ifdef SIMD_X86
+/*
+	AVX2 + FMA kernels. everything up to the pop is compiled for that target
+	and only ever called after detect_simd() found it
+*/
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+
+template <class T>
+struct Avx2;
+template <>
+struct Avx2<double> {
+	typedef __m256d V;
+	static const size_t W = 4;
+	static V zero() { return _mm256_setzero_pd(); }
+	static V set1(const double a) { return _mm256_set1_pd(a); }
+	static V load(const double* p) { return _mm256_loadu_pd(p); }
+	static void store(double* p, const V v) { _mm256_storeu_pd(p, v); }
+	static V add(const V a, const V b) { return _mm256_add_pd(a, b); }
+	static V mul(const V a, const V b) { return _mm256_mul_pd(a, b); }
+	static V fmadd(const V a, const V b, const V c) { return _mm256_fmadd_pd(a, b, c); }
+};
+template <>
+struct Avx2<float> {
+	typedef __m256 V;
+	static const size_t W = 8;
+	static V zero() { return _mm256_setzero_ps(); }
+	static V set1(const float a) { return _mm256_set1_ps(a); }
+	static V load(const float* p) { return _mm256_loadu_ps(p); }
+	static void store(float* p, const V v) { _mm256_storeu_ps(p, v); }
+	static V add(const V a, const V b) { return _mm256_add_ps(a, b); }
+	static V mul(const V a, const V b) { return _mm256_mul_ps(a, b); }
+	static V fmadd(const V a, const V b, const V c) { return _mm256_fmadd_ps(a, b, c); }
+};
+
+/* lanes are added in order so the result does not depend on the compiler */
+template <class T>
+T hsum_avx2(const typename Avx2<T>::V v) {
+	T lanes[Avx2<T>::W];
+	Avx2<T>::store(lanes, v);
+	T ret = 0;
+	for (size_t k = 0; k < Avx2<T>::W; ++k) ret += lanes[k];
+	return ret;
+}
+
+/* two accumulators hide the FMA latency */
+template <class T>
+T dot_avx2(const T* a, const T* b, const size_t n) {
+	typedef Avx2<T> S;
+	typename S::V s0 = S::zero(), s1 = S::zero();
+	size_t i = 0;
+	for (; i + 2 * S::W <= n; i += 2 * S::W) {
+		s0 = S::fmadd(S::load(a + i), S::load(b + i), s0);
+		s1 = S::fmadd(S::load(a + i + S::W), S::load(b + i + S::W), s1);
+	}
+	for (; i + S::W <= n; i += S::W) s0 = S::fmadd(S::load(a + i), S::load(b + i), s0);
+	return hsum_avx2<T>(S::add(s0, s1)) + dot_scalar(a + i, b + i, n - i);
+}
+template <class T>
+void axpy_avx2(T* y, const T a, const T* x, const size_t n) {
+	typedef Avx2<T> S;
+	typename S::V va = S::set1(a);
+	size_t i = 0;
+	for (; i + S::W <= n; i += S::W) S::store(y + i, S::fmadd(va, S::load(x + i), S::load(y + i)));
+	axpy_scalar(y + i, a, x + i, n - i);
+}
+template <class T>
+void xpay_avx2(T* y, const T a, const T* x, const size_t n) {
+	typedef Avx2<T> S;
+	typename S::V va = S::set1(a);
+	size_t i = 0;
+	for (; i + S::W <= n; i += S::W) S::store(y + i, S::fmadd(va, S::load(y + i), S::load(x + i)));
+	xpay_scalar(y + i, a, x + i, n - i);
+}
+template <class T>
+T axpy_dot_avx2(T* y, const T a, const T* x, const size_t n) {
+	typedef Avx2<T> S;
+	typename S::V va = S::set1(a), s = S::zero();
+	size_t i = 0;
+	for (; i + S::W <= n; i += S::W) {
+		typename S::V v = S::fmadd(va, S::load(x + i), S::load(y + i));
+		S::store(y + i, v);
+		s = S::fmadd(v, v, s);
+	}
+	return hsum_avx2<T>(s) + axpy_dot_scalar(y + i, a, x + i, n - i);
+}
+template <class T>
+void stencil_row_avx2(const T* up, const T* mid, const T* down, const T c, const T o, T* y, const size_t n) {
+	typedef Avx2<T> S;
+	typename S::V vc = S::set1(c), vo = S::set1(o);
+	size_t j = 0;
+	for (; j + S::W <= n; j += S::W) {
+		typename S::V s = S::add(S::add(S::load(up + j), S::load(down + j)), S::add(S::load(mid + j - 1), S::load(mid + j + 1)));
+		S::store(y + j, S::fmadd(vc, S::load(mid + j), S::mul(vo, s)));
+	}
+	stencil_row_scalar(up + j, mid + j, down + j, c, o, y + j, n - j);
+}
+
+#pragma GCC pop_options
+
+/* the same kernels on 512-bit registers */
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+
+template <class T>
+struct Avx512;
+template <>
+struct Avx512<double> {
+	typedef __m512d V;
+	static const size_t W = 8;
+	static V zero() { return _mm512_setzero_pd(); }
+	static V set1(const double a) { return _mm512_set1_pd(a); }
+	static V load(const double* p) { return _mm512_loadu_pd(p); }
+	static void store(double* p, const V v) { _mm512_storeu_pd(p, v); }
+	static V add(const V a, const V b) { return _mm512_add_pd(a, b); }
+	static V mul(const V a, const V b) { return _mm512_mul_pd(a, b); }
+	static V fmadd(const V a, const V b, const V c) { return _mm512_fmadd_pd(a, b, c); }
+};
+template <>
+struct Avx512<float> {
+	typedef __m512 V;
+	static const size_t W = 16;
+	static V zero() { return _mm512_setzero_ps(); }
+	static V set1(const float a) { return _mm512_set1_ps(a); }
+	static V load(const float* p) { return _mm512_loadu_ps(p); }
+	static void store(float* p, const V v) { _mm512_storeu_ps(p, v); }
+	static V add(const V a, const V b) { return _mm512_add_ps(a, b); }
+	static V mul(const V a, const V b) { return _mm512_mul_ps(a, b); }
+	static V fmadd(const V a, const V b, const V c) { return _mm512_fmadd_ps(a, b, c); }
+};
+
+template <class T>
+T hsum_avx512(const typename Avx512<T>::V v) {
+	T lanes[Avx512<T>::W];
+	Avx512<T>::store(lanes, v);
+	T ret = 0;
+	for (size_t k = 0; k < Avx512<T>::W; ++k) ret += lanes[k];
+	return ret;
+}
+
+template <class T>
+T dot_avx512(const T* a, const T* b, const size_t n) {
+	typedef Avx512<T> S;
+	typename S::V s0 = S::zero(), s1 = S::zero();
+	size_t i = 0;
+	for (; i + 2 * S::W <= n; i += 2 * S::W) {
+		s0 = S::fmadd(S::load(a + i), S::load(b + i), s0);
+		s1 = S::fmadd(S::load(a + i + S::W), S::load(b + i + S::W), s1);
+	}
+	for (; i + S::W <= n; i += S::W) s0 = S::fmadd(S::load(a + i), S::load(b + i), s0);
+	return hsum_avx512<T>(S::add(s0, s1)) + dot_scalar(a + i, b + i, n - i);
+}
+template <class T>
+void axpy_avx512(T* y, const T a, const T* x, const size_t n) {
+	typedef Avx512<T> S;
+	typename S::V va = S::set1(a);
+	size_t i = 0;
+	for (; i + S::W <= n; i += S::W) S::store(y + i, S::fmadd(va, S::load(x + i), S::load(y + i)));
+	axpy_scalar(y + i, a, x + i, n - i);
+}
+template <class T>
+void xpay_avx512(T* y, const T a, const T* x, const size_t n) {
+	typedef Avx512<T> S;
+	typename S::V va = S::set1(a);
+	size_t i = 0;
+	for (; i + S::W <= n; i += S::W) S::store(y + i, S::fmadd(va, S::load(y + i), S::load(x + i)));
+	xpay_scalar(y + i, a, x + i, n - i);
+}
+template <class T>
+T axpy_dot_avx512(T* y, const T a, const T* x, const size_t n) {
+	typedef Avx512<T> S;
+	typename S::V va = S::set1(a), s = S::zero();
+	size_t i = 0;
+	for (; i + S::W <= n; i += S::W) {
+		typename S::V v = S::fmadd(va, S::load(x + i), S::load(y + i));
+		S::store(y + i, v);
+		s = S::fmadd(v, v, s);
+	}
+	return hsum_avx512<T>(s) + axpy_dot_scalar(y + i, a, x + i, n - i);
+}
+template <class T>
+void stencil_row_avx512(const T* up, const T* mid, const T* down, const T c, const T o, T* y, const size_t n) {
+	typedef Avx512<T> S;
+	typename S::V vc = S::set1(c), vo = S::set1(o);
+	size_t j = 0;
+	for (; j + S::W <= n; j += S::W) {
+		typename S::V s = S::add(S::add(S::load(up + j), S::load(down + j)), S::add(S::load(mid + j - 1), S::load(mid + j + 1)));
+		S::store(y + j, S::fmadd(vc, S::load(mid + j), S::mul(vo, s)));
+	}
+	stencil_row_scalar(up + j, mid + j, down + j, c, o, y + j, n - j);
+}
+
+#pragma GCC pop_options
+#endif
+
+/*
+	dispatch on simd_level, the kernels every solver loop goes through
+	all of them work on n contiguous elements and never allocate
+*/
+template <class T>
+T dot_kernel(const T* a, const T* b, const size_t n) {
+#ifdef SIMD_X86
+	if constexpr (simd_type<T>::value) {
+		if (simd_level == SIMD_AVX512) return dot_avx512(a, b, n);
+		if (simd_level == SIMD_AVX2) return dot_avx2(a, b, n);
+	}
+#endif
+	return dot_scalar(a, b, n);
+}
+template <class T>
+void axpy_kernel(T* y, const T a, const T* x, const size_t n) {
+#ifdef SIMD_X86
+	if constexpr (simd_type<T>::value) {
+		if (simd_level == SIMD_AVX512) return axpy_avx512(y, a, x, n);
+		if (simd_level == SIMD_AVX2) return axpy_avx2(y, a, x, n);
+	}
+#endif
+	axpy_scalar(y, a, x, n);
+}
+template <class T>
+void xpay_kernel(T* y, const T a, const T* x, const size_t n) {
+#ifdef SIMD_X86
+	if constexpr (simd_type<T>::value) {
+		if (simd_level == SIMD_AVX512) return xpay_avx512(y, a, x, n);
+		if (simd_level == SIMD_AVX2) return xpay_avx2(y, a, x, n);
+	}
+#endif
+	xpay_scalar(y, a, x, n);
+}
+template <class T>
+T axpy_dot_kernel(T* y, const T a, const T* x, const size_t n) {
+#ifdef SIMD_X86
+	if constexpr (simd_type<T>::value) {
+		if (simd_level == SIMD_AVX512) return axpy_dot_avx512(y, a, x, n);
+		if (simd_level == SIMD_AVX2) return axpy_dot_avx2(y, a, x, n);
+	}
+#endif
+	return axpy_dot_scalar(y, a, x, n);
+}
+template <class T>
+void stencil_row_kernel(const T* up, const T* mid, const T* down, const T c, const T o, T* y, const size_t n) {
+#ifdef SIMD_X86
+	if constexpr (simd_type<T>::value) {
+		if (simd_level == SIMD_AVX512) return stencil_row_avx512(up, mid, down, c, o, y, n);
+		if (simd_level == SIMD_AVX2) return stencil_row_avx2(up, mid, down, c, o, y, n);
+	}
+#endif
+	stencil_row_scalar(up, mid, down, c, o, y, n);
+}
+
+/*
+	allocator handing out storage aligned to a cache line
+	lets the dense kernels stream rows with aligned loads
+*/
+template <class T, size_t Align = 64>
+struct AlignedAllocator {
+	typedef T value_type;
+	template <class U>
+	struct rebind { typedef AlignedAllocator<U, Align> other; };
+
+	AlignedAllocator() {}
+	template <class U>
+	AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+	T* allocate(const size_t n) {
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+	}
+	void deallocate(T* p, const size_t) {
+		::operator delete(p, std::align_val_t(Align));
+	}
+	template <class U>
+	bool operator == (const AlignedAllocator<U, Align>&) const { return true; }
+	template <class U>
+	bool operator != (const AlignedAllocator<U, Align>&) const { return false; }
+};
+
+/*
+	non-owning strided window into a matrix buffer
+	element (i, j) lives at ptr[i * row_stride + j * col_stride]
+	the viewed matrix must outlive the view
+*/
+template <class T>
+class MatrixView {
+public:
+	T* ptr;
+	size_t row_size, col_size, row_stride, col_stride;
+
+	MatrixView(T* p, const size_t r_s, const size_t c_s, const size_t r_st, const size_t c_st) {
+		ptr = p;
+		row_size = r_s, col_size = c_s;
+		row_stride = r_st, col_stride = c_st;
+	}
+	/* a view of T converts to a read-only view of const T */
+	template <class U>
+	MatrixView(const MatrixView<U>& V) {
+		ptr = V.ptr;
+		row_size = V.row_size, col_size = V.col_size;
+		row_stride = V.row_stride, col_stride = V.col_stride;
+	}
+
+	T& operator () (const size_t row, const size_t col) const {
+		return ptr[row * row_stride + col * col_stride];
+	}
+	size_t getRowSize() const { return row_size; }
+	size_t getColSize() const { return col_size; }
+
+	/* sub-block [r0, r0 + r_s) x [c0, c0 + c_s) of this view, no copy */
+	MatrixView<T> block(const size_t r0, const size_t c0, const size_t r_s, const size_t c_s) const {
+		assert(r0 + r_s <= row_size && c0 + c_s <= col_size);
+		return MatrixView<T>(ptr + r0 * row_stride + c0 * col_stride, r_s, c_s, row_stride, col_stride);
+	}
+};
+
+/*
+	expression templates
+	elementwise +, -, unary - and scalar * on matrices build lightweight nodes
+	instead of temporaries; the whole expression is evaluated in one loop when it
+	is assigned to (or used to construct) a Matrix, so X0 + alpha * P0 is a single
+	pass over memory with a single allocation. nodes keep references to their
+	Matrix leaves, so an expression must not outlive the statement that built it
+	(do not store one in an auto variable)
+*/
+template <class E>
+struct MatrixExpr {
+	const E& self() const { return static_cast<const E&>(*this); }
+};
+
 template <class T>
-class Matrix {
+class Matrix : public MatrixExpr< Matrix<T> > {
 public:
+	typedef T value_type;
 	size_t row_size, col_size;
-	std::vector< std::vector < T > > mat;
+	/* row-major: element (i, j) is mat[i * col_size + j], one aligned allocation */
+	std::vector< T, AlignedAllocator< T > > mat;
 
 	// public:
 	Matrix();
 	Matrix(const size_t r_s, const size_t c_s);
 	Matrix(const Matrix<T>& M);
 	Matrix(Matrix<T>&& M);
+	template <class U>
+	explicit Matrix(const MatrixView<U>& V);
+	template <class E>
+	Matrix(const MatrixExpr<E>& E1);
 
 	Matrix<T>& operator = (Matrix<T>&& M);
-	Matrix<T>& operator = (Matrix<T>& M);
+	Matrix<T>& operator = (const Matrix<T>& M);
+	template <class E>
+	Matrix<T>& operator = (const MatrixExpr<E>& E1);
+
+	T& operator () (const size_t row, const size_t col) { return mat[row * col_size + col]; }
+	const T& operator () (const size_t row, const size_t col) const { return mat[row * col_size + col]; }
+	/* flat index into the row-major buffer, handy for column vectors */
+	T& operator [] (const size_t idx) { return mat[idx]; }
+	const T& operator [] (const size_t idx) const { return mat[idx]; }
+	T* data() { return mat.data(); }
+	const T* data() const { return mat.data(); }
+	size_t size() const { return mat.size(); }
 
-	T getVal(const size_t row, const size_t col);
+	MatrixView<T> view();
+	MatrixView<const T> view() const;
+	MatrixView<T> row(const size_t r);
+	MatrixView<const T> row(const size_t r) const;
+	MatrixView<T> col(const size_t c);
+	MatrixView<const T> col(const size_t c) const;
+	MatrixView<T> block(const size_t r0, const size_t c0, const size_t r_s, const size_t c_s);
+	MatrixView<const T> block(const size_t r0, const size_t c0, const size_t r_s, const size_t c_s) const;
+
+	T getVal(const size_t row, const size_t col) const;
 	T setVal(const size_t row, const size_t col, const T value);
-	size_t getRowSize();
-	size_t getColSize();
+	size_t getRowSize() const;
+	size_t getColSize() const;
 
-	template <class ElType>
-	friend Matrix<ElType> operator - (const Matrix<ElType>& M1);
-	template <class ElType>
-	friend Matrix<ElType> operator + (const Matrix<ElType>& M1, const Matrix<ElType>& M2);
-	template <class ElType>
-	friend Matrix<ElType> operator - (const Matrix<ElType>& M1, const Matrix<ElType>& M2);
 	template <class ElType>
 	friend Matrix<ElType> operator * (const Matrix<ElType>& M1, const Matrix<ElType>& M2);
-	template <class ElType>
-	friend void operator += (Matrix<ElType>& M1, const Matrix<ElType>& M2);
-	template <class ElType>
-	friend void operator -= (Matrix<ElType>& M1, const Matrix<ElType>& M2);
+	template <class ElType, class E>
+	friend void operator += (Matrix<ElType>& M1, const MatrixExpr<E>& M2);
+	template <class ElType, class E>
+	friend void operator -= (Matrix<ElType>& M1, const MatrixExpr<E>& M2);
 	template <class ElType>
 	friend void operator *= (Matrix<ElType>& M1, const Matrix<ElType>& M2);
 
@@ -68,15 +688,7 @@ template <class T>
 Matrix<T>::Matrix(const size_t r_s, const size_t c_s) {
 	row_size = r_s;
 	col_size = c_s;
-	mat.resize(row_size);
-	for (size_t i = 0; i < row_size; i++) {
-		mat[i].resize(col_size);
-	}
-	for (size_t i = 0; i < row_size; ++i) {
-		for (size_t j = 0; j < col_size; ++j) {
-			mat[i][j] = 0;
-		}
-	}
+	mat.assign(row_size * col_size, T(0));
 }
 
 /*
@@ -88,15 +700,7 @@ template <class T>
 Matrix<T>::Matrix(const Matrix<T>& M) {
 	row_size = M.row_size;
 	col_size = M.col_size;
-	mat.resize(row_size);
-	for (size_t i = 0; i < row_size; i++) {
-		mat[i].resize(col_size);
-	}
-	for (size_t i = 0; i < row_size; i++) {
-		for (size_t j = 0; j < col_size; j++) {
-			mat[i][j] = M.mat[i][j];
-		}
-	}
+	mat = M.mat;
 }
 
 /*
@@ -105,9 +709,45 @@ Matrix<T>::Matrix(const Matrix<T>& M) {
 */
 template <class T>
 Matrix<T>::Matrix(Matrix<T>&& M) {
-	row_size = std::move(M.row_size);
-	col_size = std::move(M.col_size);
+	row_size = M.row_size;
+	col_size = M.col_size;
 	mat = std::move(M.mat);
+	M.row_size = M.col_size = 0;
+}
+
+/*
+	materialises a (possibly strided) view into a dense matrix
+	O(row*col) time complexity
+*/
+template <class T>
+template <class U>
+Matrix<T>::Matrix(const MatrixView<U>& V) {
+	row_size = V.row_size;
+	col_size = V.col_size;
+	mat.resize(row_size * col_size);
+	for (size_t i = 0; i < row_size; i++) {
+		for (size_t j = 0; j < col_size; j++) {
+			mat[i * col_size + j] = V(i, j);
+		}
+	}
+}
+
+/*
+	evaluates an expression into a new matrix
+	one pass, one allocation
+*/
+template <class T>
+template <class E>
+Matrix<T>::Matrix(const MatrixExpr<E>& E1) {
+	const E& e = E1.self();
+	row_size = e.getRowSize();
+	col_size = e.getColSize();
+	mat.resize(row_size * col_size);
+	T* out = mat.data();
+	OMP(omp parallel for if(run_parallel(mat.size())) schedule(static))
+	for (size_t i = 0; i < mat.size(); i++) {
+		out[i] = e[i];
+	}
 }
 
 /* destructor declaration */
@@ -118,22 +758,56 @@ Matrix<T>::~Matrix() {
 
 /* Class functions */
 template <class T>
-T Matrix<T>::getVal(const size_t row, const size_t col) {
-	return mat[row][col];
+T Matrix<T>::getVal(const size_t row, const size_t col) const {
+	return mat[row * col_size + col];
 }
 template <class T>
 T Matrix<T>::setVal(const size_t row, const size_t col, const T value) {
-	return mat[row][col] = value;
+	return mat[row * col_size + col] = value;
 }
 template <class T>
-size_t Matrix<T>::getRowSize() {
+size_t Matrix<T>::getRowSize() const {
 	return row_size;
 }
 template <class T>
-size_t Matrix<T>::getColSize() {
+size_t Matrix<T>::getColSize() const {
 	return col_size;
 }
 
+/* views: O(1), nothing is copied */
+template <class T>
+MatrixView<T> Matrix<T>::view() {
+	return MatrixView<T>(mat.data(), row_size, col_size, col_size, 1);
+}
+template <class T>
+MatrixView<const T> Matrix<T>::view() const {
+	return MatrixView<const T>(mat.data(), row_size, col_size, col_size, 1);
+}
+template <class T>
+MatrixView<T> Matrix<T>::row(const size_t r) {
+	return view().block(r, 0, 1, col_size);
+}
+template <class T>
+MatrixView<const T> Matrix<T>::row(const size_t r) const {
+	return view().block(r, 0, 1, col_size);
+}
+template <class T>
+MatrixView<T> Matrix<T>::col(const size_t c) {
+	return view().block(0, c, row_size, 1);
+}
+template <class T>
+MatrixView<const T> Matrix<T>::col(const size_t c) const {
+	return view().block(0, c, row_size, 1);
+}
+template <class T>
+MatrixView<T> Matrix<T>::block(const size_t r0, const size_t c0, const size_t r_s, const size_t c_s) {
+	return view().block(r0, c0, r_s, c_s);
+}
+template <class T>
+MatrixView<const T> Matrix<T>::block(const size_t r0, const size_t c0, const size_t r_s, const size_t c_s) const {
+	return view().block(r0, c0, r_s, c_s);
+}
+
 
 /*
 	Move Assignment operator
@@ -141,82 +815,128 @@ size_t Matrix<T>::getColSize() {
 */
 template<class T>
 Matrix<T>& Matrix<T>::operator = (Matrix<T>&& M) {
-	row_size = std::move(M.row_size);
-	col_size = std::move(M.col_size);
+	row_size = M.row_size;
+	col_size = M.col_size;
 	mat = std::move(M.mat);
+	M.row_size = M.col_size = 0;
 	return *this;
 }
 
 /*
 	Copy Assignment operator
 	performs deepcopy : O(row*col) time complexity
+	the buffer is reused when it is already large enough
 */
 template<class T>
-Matrix<T>& Matrix<T>::operator = (Matrix<T>& M) {
+Matrix<T>& Matrix<T>::operator = (const Matrix<T>& M) {
 	row_size = M.row_size;
 	col_size = M.col_size;
-	for (size_t i = 0; i < row_size; i++) {
-		for (size_t j = 0; j < row_size; j++) {
-			mat[i][j] = M.mat[i][j];
-		}
+	mat.assign(M.mat.begin(), M.mat.end());
+	return *this;
+}
+
+/*
+	Expression Assignment operator
+	evaluated straight into the existing buffer when the shape matches; every
+	node is elementwise, so the target may also appear inside the expression
+*/
+template<class T>
+template<class E>
+Matrix<T>& Matrix<T>::operator = (const MatrixExpr<E>& E1) {
+	const E& e = E1.self();
+	if (row_size != e.getRowSize() || col_size != e.getColSize()) {
+		/* evaluate first: the old buffer may still be read by the expression */
+		Matrix<T> res(E1);
+		return *this = std::move(res);
+	}
+	T* out = mat.data();
+	OMP(omp parallel for if(run_parallel(mat.size())) schedule(static))
+	for (size_t i = 0; i < mat.size(); i++) {
+		out[i] = e[i];
 	}
 	return *this;
 }
 
-/* friend functions*/
-/* returns -1*Matrix */
+/* expression nodes hold Matrix leaves by reference and inner nodes by value */
+template <class E>
+struct expr_operand { typedef const E type; };
 template <class T>
-Matrix<T> operator- (const Matrix<T>& M) {
-	Matrix<T> res(M.row_size, M.col_size);
-	for (size_t i = 0; i < M.row_size; i++) {
-		for (size_t j = 0; j < M.col_size; j++) {
-			res.mat[i][j] = -M.mat[i][j];
-		}
+struct expr_operand< Matrix<T> > { typedef const Matrix<T>& type; };
+
+struct ExprAdd {
+	template <class T>
+	static T apply(const T& a, const T& b) { return a + b; }
+};
+struct ExprSub {
+	template <class T>
+	static T apply(const T& a, const T& b) { return a - b; }
+};
+
+/* L op R, elementwise */
+template <class L, class R, class Op>
+class MatrixBinaryExpr : public MatrixExpr< MatrixBinaryExpr<L, R, Op> > {
+public:
+	typedef typename L::value_type value_type;
+	typename expr_operand<L>::type l;
+	typename expr_operand<R>::type r;
+
+	MatrixBinaryExpr(const L& L1, const R& R1) : l(L1), r(R1) {
+		/* to check wheter the matrices have same dimensions */
+		assert(l.getRowSize() == r.getRowSize() && l.getColSize() == r.getColSize());
 	}
-	return res;
+	value_type operator [] (const size_t idx) const { return Op::apply(l[idx], r[idx]); }
+	size_t getRowSize() const { return l.getRowSize(); }
+	size_t getColSize() const { return l.getColSize(); }
+};
+
+/* val * E */
+template <class E>
+class MatrixScaledExpr : public MatrixExpr< MatrixScaledExpr<E> > {
+public:
+	typedef typename E::value_type value_type;
+	value_type val;
+	typename expr_operand<E>::type e;
+
+	MatrixScaledExpr(const value_type& v, const E& E1) : val(v), e(E1) {}
+	value_type operator [] (const size_t idx) const { return val * e[idx]; }
+	size_t getRowSize() const { return e.getRowSize(); }
+	size_t getColSize() const { return e.getColSize(); }
+};
+
+/* -1*Matrix */
+template <class E>
+MatrixScaledExpr<E> operator- (const MatrixExpr<E>& M) {
+	return MatrixScaledExpr<E>(-1, M.self());
 }
 
 /*
 	operator overloaded for matrix addition
-	returns Matrix1 + Matrix2
+	returns the lazy node for Matrix1 + Matrix2
 */
-template <class T>
-Matrix<T> operator+ (const Matrix<T>& M1, const Matrix<T>& M2) {
-	/*to check wheter the matrices have same dimensions*/
-	if (M1.row_size != M2.row_size || M1.col_size != M2.col_size) {
-		return M1;
-	}
-	Matrix<T> res(M1.row_size, M1.col_size);
-	for (size_t i = 0; i < M1.row_size; i++) {
-		for (size_t j = 0; j < M1.col_size; j++) {
-			res.mat[i][j] = M1.mat[i][j] + M2.mat[i][j];
-		}
-	}
-	return res;
+template <class E1, class E2>
+MatrixBinaryExpr<E1, E2, ExprAdd> operator+ (const MatrixExpr<E1>& M1, const MatrixExpr<E2>& M2) {
+	return MatrixBinaryExpr<E1, E2, ExprAdd>(M1.self(), M2.self());
 }
 
 /*
 	operator overloaded for matrix subtraction
-	returns Matrix1 - Matrix2
+	returns the lazy node for Matrix1 - Matrix2
 */
-template <class T>
-Matrix<T> operator- (const Matrix<T>& M1, const Matrix<T>& M2) {
-	/*to check wheter the matrices have same dimensions*/
-	if (M1.row_size != M2.row_size || M1.col_size != M2.col_size) {
-		return M1;
-	}
-	Matrix<T> res(M1.row_size, M1.col_size);
-	for (size_t i = 0; i < M1.row_size; i++) {
-		for (size_t j = 0; j < M1.col_size; j++) {
-			res.mat[i][j] = M1.mat[i][j] - M2.mat[i][j];
-		}
-	}
-	return res;
+template <class E1, class E2>
+MatrixBinaryExpr<E1, E2, ExprSub> operator- (const MatrixExpr<E1>& M1, const MatrixExpr<E2>& M2) {
+	return MatrixBinaryExpr<E1, E2, ExprSub>(M1.self(), M2.self());
+}
+
+/* scalar * Matrix, lazy */
+template <class E>
+MatrixScaledExpr<E> operator* (const typename E::value_type& val, const MatrixExpr<E>& M) {
+	return MatrixScaledExpr<E>(val, M.self());
 }
 
 /*
 	operator overloaded for matrix multiplication
 	returns Matrix1 * Matrix2
+	i-k-j loop order so both M2 and the result are walked along rows
 */
 template <class T>
 Matrix<T> operator* (const Matrix<T>& M1, const Matrix<T>& M2) {
@@ -226,11 +946,14 @@ Matrix<T> operator* (const Matrix<T>& M1, const Matrix<T>& M2) {
 	}
 	/* O(M1.row * M1.col * M2.col) time complexity */
 	Matrix<T> res(M1.row_size, M2.col_size);
+	OMP(omp parallel for if(run_parallel(M1.row_size * M1.col_size * M2.col_size)) schedule(static))
 	for (size_t i = 0; i < M1.row_size; i++) {
-		for (size_t j = 0; j < M2.col_size; j++) {
-			res.mat[i][j] = 0;
-			for (size_t k = 0; k < M1.col_size; k++)
-				res.mat[i][j] += M1.mat[i][k] * M2.mat[k][j];
+		T* res_row = res.data() + i * res.col_size;
+		for (size_t k = 0; k < M1.col_size; k++) {
+			const T a = M1(i, k);
+			const T* m2_row = M2.data() + k * M2.col_size;
+			for (size_t j = 0; j < M2.col_size; j++)
+				res_row[j] += a * m2_row[j];
 		}
 	}
 	return res;
@@ -238,36 +961,34 @@ Matrix<T> operator* (const Matrix<T>& M1, const Matrix<T>& M2) {
 
 /*
 	operator overloaded for matrix self addition
-	performs Matrix1 = Matrix1 + Matrix2
+	performs Matrix1 = Matrix1 + Matrix2, Matrix2 may be any expression
 */
-template <class T>
-void operator+= (Matrix<T>& M1, const Matrix<T>& M2) {
+template <class T, class E>
+void operator+= (Matrix<T>& M1, const MatrixExpr<E>& M2) {
+	const E& e = M2.self();
 	/* to check wheter the matrices have same dimensions */
-	if (M1.row_size != M2.row_size || M1.col_size != M2.col_size) {
+	if (M1.row_size != e.getRowSize() || M1.col_size != e.getColSize()) {
 		return;
 	}
-	for (size_t i = 0; i < M1.row_size; i++) {
-		for (size_t j = 0; j < M1.col_size; j++) {
-			M1.mat[i][j] = M1.mat[i][j] + M2.mat[i][j];
-		}
+	for (size_t i = 0; i < M1.mat.size(); i++) {
+		M1.mat[i] += e[i];
 	}
 	return;
 }
 
 /*
 	operator overloaded for matrix self subtraction
-	performs Matrix1 = Matrix1 - Matrix2
+	performs Matrix1 = Matrix1 - Matrix2, Matrix2 may be any expression
 */
-template <class T>
-void operator-= (Matrix<T>& M1, const Matrix<T>& M2) {
+template <class T, class E>
+void operator-= (Matrix<T>& M1, const MatrixExpr<E>& M2) {
+	const E& e = M2.self();
 	/* to check wheter the matrices have same dimensions */
-	if (M1.row_size != M2.row_size || M1.col_size != M2.col_size) {
+	if (M1.row_size != e.getRowSize() || M1.col_size != e.getColSize()) {
 		return;
 	}
-	for (size_t i = 0; i < M1.row_size; i++) {
-		for (size_t j = 0; j < M1.col_size; j++) {
-			M1.mat[i][j] = M1.mat[i][j] - M2.mat[i][j];
-		}
+	for (size_t i = 0; i < M1.mat.size(); i++) {
+		M1.mat[i] -= e[i];
 	}
 	return;
 }
@@ -283,30 +1004,7 @@ inline void operator*=(Matrix<T>& M1, const Matrix<T>& M2) {
 		return;
 	}
 	/* alocating O(row*col) additional memory to find the resultant */
-	Matrix<T> res(M1.row_size, M2.col_size);
-	for (size_t i = 0; i < M1.row_size; i++) {
-		for (size_t j = 0; j < M2.col_size; j++) {
-			res.mat[i][j] = 0;
-			for (size_t k = 0; k < M1.col_size; k++)
-				res.mat[i][j] += M1.mat[i][k] * M2.mat[k][j];
-		}
-	}
-	size_t r = M1.row_size, c = M2.col_size;
-	for (size_t i = 0; i < M1.row_size; i++) {
-		M1.mat[i].clear();
-	}
-	M1.mat.clear();
-	M1.mat.resize(r);
-	M1.row_size = r;
-	M1.col_size = c;
-	for (size_t i = 0; i < r; i++) {
-		M1.mat[i].resize(c);
-	}
-	for (size_t i = 0; i < M1.row_size; i++) {
-		for (size_t j = 0; j < M1.col_size; j++) {
-			M1.mat[i][j] = res.mat[i][j];
-		}
-	}
+	M1 = M1 * M2;
 	return;
 }
 /* returns Trace: sum of the body diagnol elements of a square matrix */
@@ -330,27 +1028,161 @@ Matrix<T> trans(Matrix<T>& X) {
 	return ret;
 }
 
+/* a . b; either side may be an unevaluated expression, which is fused into the sum */
+template <class E1, class E2>
+typename E1::value_type dot(const MatrixExpr<E1>& A, const MatrixExpr<E2>& B) {
+	const E1& a = A.self();
+	const E2& b = B.self();
+	assert(a.getRowSize() == b.getRowSize() && a.getColSize() == b.getColSize());
+	typedef typename E1::value_type T;
+	return blocked_sum<T>(a.getRowSize() * a.getColSize(), [&](size_t begin, size_t end) {
+		T ret = 0;
+		for (size_t i = begin; i < end; ++i) {
+			ret += a[i] * b[i];
+		}
+		return ret;
+	});
+}
+
+/* plain vectors go straight to the SIMD kernel */
 template <class T>
-T dot(Matrix<T> a, Matrix<T> b) {
+T dot(const Matrix<T>& a, const Matrix<T>& b) {
 	assert(a.getRowSize() == b.getRowSize() && a.getColSize() == b.getColSize());
-	T ret = 0;
-	for (size_t i = 0; i < a.getRowSize(); ++i) {
-		for (size_t j = 0; j < b.getColSize(); ++j) {
-			ret += a.getVal(i, j) * b.getVal(i, j);
+	PhaseTimer timer(PHASE_AXPY);
+	return blocked_sum<T>(a.size(), [&](size_t begin, size_t end) {
+		return dot_kernel(a.data() + begin, b.data() + begin, end - begin);
+	});
+}
+
+/*
+	in-place vector kernels used by the solver loops
+	they work on preallocated operands and never allocate
+*/
+/* y = y + a * x */
+template <class T>
+void axpy(Matrix<T>& y, const T a, const Matrix<T>& x) {
+	assert(y.size() == x.size());
+	PhaseTimer timer(PHASE_AXPY);
+	blocked_for(y.size(), [&](size_t begin, size_t end) {
+		axpy_kernel(y.data() + begin, a, x.data() + begin, end - begin);
+	});
+}
+
+/* y = x + a * y */
+template <class T>
+void xpay(Matrix<T>& y, const T a, const Matrix<T>& x) {
+	assert(y.size() == x.size());
+	PhaseTimer timer(PHASE_AXPY);
+	blocked_for(y.size(), [&](size_t begin, size_t end) {
+		xpay_kernel(y.data() + begin, a, x.data() + begin, end - begin);
+	});
+}
+
+/* y = y + a * x and returns the new y.y in the same pass */
+template <class T>
+T axpy_dot(Matrix<T>& y, const T a, const Matrix<T>& x) {
+	assert(y.size() == x.size());
+	PhaseTimer timer(PHASE_AXPY);
+	return blocked_sum<T>(y.size(), [&](size_t begin, size_t end) {
+		return axpy_dot_kernel(y.data() + begin, a, x.data() + begin, end - begin);
+	});
+}
+
+/*
+	column-wise kernels for n x k blocks of vectors (one vector per column), used
+	by the multiple right-hand side solver: every call is a single pass over the rows
+*/
+/* out[c] = a(:, c) . b(:, c) for all k columns, summed per REDUCE_BLOCK rows like blocked_sum */
+template <class T>
+void column_dots(const Matrix<T>& a, const Matrix<T>& b, T* out) {
+	assert(a.getRowSize() == b.getRowSize() && a.getColSize() == b.getColSize());
+	PhaseTimer timer(PHASE_AXPY);
+	size_t n = a.getRowSize(), k = a.getColSize(), blocks = (n + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+	static thread_local vector < T > sums;
+	if (sums.size() < blocks * k) sums.resize(blocks * k);
+	T* s = sums.data();
+	const T* pa = a.data();
+	const T* pb = b.data();
+	OMP(omp parallel for if(run_parallel(n * k)) schedule(static))
+	for (size_t bl = 0; bl < blocks; ++bl) {
+		T* __restrict part = s + bl * k;
+		std::fill(part, part + k, T(0));
+		for (size_t i = bl * REDUCE_BLOCK; i < min(n, (bl + 1) * REDUCE_BLOCK); ++i) {
+			const T* __restrict x = pa + i * k;
+			const T* __restrict y = pb + i * k;
+			OMP(omp simd)
+			for (size_t c = 0; c < k; ++c) part[c] += x[c] * y[c];
 		}
 	}
-	return ret;
+	for (size_t c = 0; c < k; ++c) {
+		out[c] = 0;
+		for (size_t bl = 0; bl < blocks; ++bl) out[c] += s[bl * k + c];
+	}
 }
 
+/* y(:, c) = y(:, c) + a[c] * x(:, c) */
 template <class T>
-Matrix <T> operator * (const T& val, Matrix <T>& A) {
-	Matrix <T> ret(A.getRowSize(), A.getColSize());
-	for (size_t i = 0; i < A.getRowSize(); ++i) {
-		for (size_t j = 0; j < A.getColSize(); ++j) {
-			ret.setVal(i, j, val * A.getVal(i, j));
+void column_axpy(Matrix<T>& y, const T* a, const Matrix<T>& x) {
+	assert(y.size() == x.size());
+	PhaseTimer timer(PHASE_AXPY);
+	size_t n = y.getRowSize(), k = y.getColSize();
+	T* py = y.data();
+	const T* px = x.data();
+	OMP(omp parallel for if(run_parallel(y.size())) schedule(static))
+	for (size_t i = 0; i < n; ++i) {
+		T* __restrict yi = py + i * k;
+		const T* __restrict xi = px + i * k;
+		OMP(omp simd)
+		for (size_t c = 0; c < k; ++c) yi[c] += a[c] * xi[c];
+	}
+}
+
+/* y(:, c) = y(:, c) + a[c] * x(:, c) and out[c] = y(:, c) . y(:, c) in the same pass */
+template <class T>
+void column_axpy_dot(Matrix<T>& y, const T* a, const Matrix<T>& x, T* out) {
+	assert(y.size() == x.size());
+	PhaseTimer timer(PHASE_AXPY);
+	size_t n = y.getRowSize(), k = y.getColSize(), blocks = (n + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+	static thread_local vector < T > sums;
+	if (sums.size() < blocks * k) sums.resize(blocks * k);
+	T* s = sums.data();
+	T* py = y.data();
+	const T* px = x.data();
+	OMP(omp parallel for if(run_parallel(n * k)) schedule(static))
+	for (size_t bl = 0; bl < blocks; ++bl) {
+		T* __restrict part = s + bl * k;
+		std::fill(part, part + k, T(0));
+		for (size_t i = bl * REDUCE_BLOCK; i < min(n, (bl + 1) * REDUCE_BLOCK); ++i) {
+			T* __restrict yi = py + i * k;
+			const T* __restrict xi = px + i * k;
+			OMP(omp simd)
+			for (size_t c = 0; c < k; ++c) {
+				yi[c] += a[c] * xi[c];
+				part[c] += yi[c] * yi[c];
+			}
 		}
 	}
-	return ret;
+	for (size_t c = 0; c < k; ++c) {
+		out[c] = 0;
+		for (size_t bl = 0; bl < blocks; ++bl) out[c] += s[bl * k + c];
+	}
+}
+
+/* y(:, c) = x(:, c) + a[c] * y(:, c) */
+template <class T>
+void column_xpay(Matrix<T>& y, const T* a, const Matrix<T>& x) {
+	assert(y.size() == x.size());
+	PhaseTimer timer(PHASE_AXPY);
+	size_t n = y.getRowSize(), k = y.getColSize();
+	T* py = y.data();
+	const T* px = x.data();
+	OMP(omp parallel for if(run_parallel(y.size())) schedule(static))
+	for (size_t i = 0; i < n; ++i) {
+		T* __restrict yi = py + i * k;
+		const T* __restrict xi = px + i * k;
+		OMP(omp simd)
+		for (size_t c = 0; c < k; ++c) yi[c] = xi[c] + a[c] * yi[c];
+	}
 }
 
 template < typename T >
@@ -360,10 +1192,13 @@ public:
 	vector < T > val;
 	int size, n, m;
 
-	Matrix_coo() {}
+	Matrix_coo() {
+		size = n = m = 0;
+	}
 
 	Matrix_coo(int N, int M) {
 		n = N, m = M;
+		size = 0;
 	}
 
 	void Insert_element(int a, int b, T c) {
@@ -384,18 +1219,18 @@ public:
 };
 
 template < class T>
-Matrix <T> operator * (Matrix_coo <T> A, Matrix <T> b) {
+Matrix <T> operator * (const Matrix_coo <T>& A, const Matrix <T>& b) {
 	Matrix < T > ret(A.n, b.getColSize());
 	for (size_t i = 0; i < A.size; ++i) {
 		for (size_t j = 0; j < b.getColSize(); ++j) {
-			ret.mat[A.row[i]][j] += A.val[i] * b.mat[A.col[i]][j];
+			ret(A.row[i], j) += A.val[i] * b(A.col[i], j);
 		}
 	}
 	return ret;
 }
 
 template < class T>
-Matrix_coo <T> operator * (const T& val, Matrix_coo <T> A) {
+Matrix_coo <T> operator * (const T& val, const Matrix_coo <T>& A) {
 	Matrix_coo < T > ret(A.n, A.m);
 	for (size_t i = 0; i < A.size; ++i) {
 		ret.Insert_element(A.row[i], A.col[i], val * A.val[i]);
@@ -403,497 +1238,4581 @@ Matrix_coo <T> operator * (const T& val, Matrix_coo <T> A) {
 	return ret;
 }
 
-int map_to_int(int i, int j, int nx, int ny) {
-	if (i >= 0 && i < nx && j >= 0 && j < ny) {
-		return i * ny + j;
+/*
+	compressed sparse row storage
+	the entries of row i are col/val[row_ptr[i] .. row_ptr[i + 1]), columns ascending
+	and duplicate (row, col) entries of the source summed
+*/
+template < typename T >
+class Matrix_csr {
+public:
+	vector < int > row_ptr, col;
+	vector < T > val;
+	int n, m;
+
+	Matrix_csr() {
+		n = m = 0;
+		row_ptr.assign(1, 0);
 	}
-	return -1;
-}
 
-int dx[] = { -1, 0, 1, 0 };
-int dy[] = { 0, 1, 0, -1 };
+	/* COO -> CSR: counting sort by row, then sort and merge each row */
+	explicit Matrix_csr(const Matrix_coo <T>& A) {
+		n = A.n, m = A.m;
+		row_ptr.assign(n + 1, 0);
+		for (int i = 0; i < A.size; ++i) row_ptr[A.row[i] + 1]++;
+		for (int i = 0; i < n; ++i) row_ptr[i + 1] += row_ptr[i];
+		vector < int > next(row_ptr.begin(), row_ptr.end() - 1), order(A.size);
+		for (int i = 0; i < A.size; ++i) order[next[A.row[i]]++] = i;
 
-pair <Matrix <long double>, Matrix <long double>> generate_dense_matrix(int nx_max, int ny_max) {
-	int nx = nx_max;
-	int ny = ny_max;
-	Matrix < long double > b(nx * ny, 1);
-	for (int i = 0; i < b.getRowSize(); ++i) {
-		b.mat[i][0] = (rand() % val_mx) * 1.0;
-	}
-	Matrix < long double > A(nx * ny, nx * ny);
-	for (int i = 0; i < A.getRowSize(); ++i) {
-		for (int j = 0; j < A.getColSize(); ++j) {
-			A.mat[i][j] = 0;
-		}
-	}
-	for (int i = 0; i < nx; ++i) {
-		for (int j = 0; j < ny; ++j) {
-			int curr = map_to_int(i, j, nx, ny);
-			for (int k = 0; k < 4; ++k) {
-				int r = map_to_int(i + dx[k], j + dy[k], nx, ny);
-				if (r != -1) A.mat[curr][r] = 1;
+		col.reserve(A.size);
+		val.reserve(A.size);
+		int k = 0;
+		for (int r = 0; r < n; ++r) {
+			sort(order.begin() + row_ptr[r], order.begin() + row_ptr[r + 1],
+				[&A](int a, int b) { return A.col[a] < A.col[b]; });
+			int begin = col.size();
+			for (; k < row_ptr[r + 1]; ++k) {
+				int e = order[k];
+				if ((int)col.size() > begin && col.back() == A.col[e]) val.back() += A.val[e];
+				else col.push_back(A.col[e]), val.push_back(A.val[e]);
 			}
-			A.mat[curr][curr] = -4;
+			row_ptr[r] = begin;
 		}
+		row_ptr[n] = col.size();
 	}
-	return { A, b };
-}
-pair <Matrix <long double>, Matrix <int> > generate_sparse_matrix(int nx_max, int ny_max) {
-	int nx = nx_max;
-	int ny = ny_max;
-	Matrix < long double > b(nx * ny, 1);
-	for (int i = 0; i < b.getRowSize(); ++i) {
-		b.mat[i][0] = (rand() % val_mx) * 1.0;
+
+	/* same matrix in another precision */
+	template <class U>
+	explicit Matrix_csr(const Matrix_csr <U>& A) {
+		n = A.n, m = A.m;
+		row_ptr = A.row_ptr;
+		col = A.col;
+		val.assign(A.val.begin(), A.val.end());
 	}
-	Matrix < int > u(nx, ny);
-	for (int i = 0; i < nx; ++i) {
-		for (int j = 0; j < ny; ++j) {
-			u.mat[i][j] = map_to_int(i, j, nx, ny);
+
+	size_t getRowSize() const { return n; }
+	size_t getColSize() const { return m; }
+	size_t nnz() const { return val.size(); }
+
+	/*
+		y = A * x for one vector. rows are processed in fixed blocks and each row
+		streams its col/val entries contiguously with a register accumulator
+	*/
+	void multiply(const T* x, T* y) const {
+		const int block = 256;
+		OMP(omp parallel for if(run_parallel(nnz())) schedule(static))
+		for (int r0 = 0; r0 < n; r0 += block) {
+			int r1 = min(n, r0 + block);
+			for (int r = r0; r < r1; ++r) {
+				T s = 0;
+				for (int k = row_ptr[r]; k < row_ptr[r + 1]; ++k) {
+					s += val[k] * x[col[k]];
+				}
+				y[r] = s;
+			}
 		}
 	}
-	return { b, u };
-}
 
-void vector_sum_MASTER(Matrix<long double>& C, Matrix <long double>& A, Matrix <long double>& B, int n, int size, int op) {
-	int operation = op, subDivide = max((n / (size - 1)), 1), start = 0, end = start + subDivide;
-	for (int i = 1; i < size; ++i) {
-		if (i == size - 1) end = n - 1;
-		MPI_Send(&operation, 1, MPI_INT, i, 12345, MPI_COMM_WORLD);
-		MPI_Send(&start, 1, MPI_INT, i, 1e5, MPI_COMM_WORLD);
-		MPI_Send(&end, 1, MPI_INT, i, 2e5, MPI_COMM_WORLD);
-		for (int j = start; j <= end; j++) {
-			MPI_Send(&A.mat[j][0], 1, MPI_LONG_DOUBLE, i, j + 1e6, MPI_COMM_WORLD);
-		}
-		for (int j = start; j <= end; j++) {
-			MPI_Send(&B.mat[j][0], 1, MPI_LONG_DOUBLE, i, j + 2e6, MPI_COMM_WORLD);
+	/*
+		Y = A * X for k vectors stored row-major (n x k): every matrix entry is
+		loaded once and applied to k contiguous values, one sweep for all of them
+	*/
+	void multiply_block(const T* x, T* y, const size_t k) const {
+		OMP(omp parallel for if(run_parallel(nnz() * k)) schedule(static))
+		for (int r = 0; r < n; ++r) {
+			T* __restrict out = y + (size_t)r * k;
+			std::fill(out, out + k, T(0));
+			for (int e = row_ptr[r]; e < row_ptr[r + 1]; ++e) {
+				const T* __restrict in = x + (size_t)col[e] * k;
+				const T v = val[e];
+				OMP(omp simd)
+				for (size_t j = 0; j < k; ++j) out[j] += v * in[j];
+			}
 		}
-		start = end + 1;
-		end = min(n - 1, start + subDivide);
 	}
-	start = 0, end = start + subDivide;
-	for (int i = 1; i < size; ++i) {
-		if (i == size - 1) end = n - 1;
-		for (int j = start; j <= end; j++) {
-			MPI_Recv(&C.mat[j][0], 1, MPI_LONG_DOUBLE, i, j, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+	Matrix_coo <T> to_coo() const {
+		Matrix_coo <T> A(n, m);
+		for (int r = 0; r < n; ++r) {
+			for (int k = row_ptr[r]; k < row_ptr[r + 1]; ++k) {
+				A.Insert_element(r, col[k], val[k]);
+			}
 		}
-		start = end + 1;
-		end = min(n - 1, start + subDivide);
-	}
-}
-void vector_sum(int rank) {
-	int n, start, end;
-	MPI_Recv(&start, 1, MPI_INT, 0, 1e5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	MPI_Recv(&end, 1, MPI_INT, 0, 2e5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	Matrix < long double > A(end - start + 1, 1), B(end - start + 1, 1), C(end - start + 1, 1);
-	for (int i = 0; i < end - start + 1; i++) {
-		MPI_Recv(&A.mat[i][0], 1, MPI_LONG_DOUBLE, 0, i + start + 1e6, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	}
-	for (int i = 0; i < end - start + 1; i++) {
-		MPI_Recv(&B.mat[i][0], 1, MPI_LONG_DOUBLE, 0, i + start + 2e6, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		return A;
 	}
-	for (int i = 0; i < end - start + 1; ++i) {
-		C.mat[i][0] = A.mat[i][0] + B.mat[i][0];
-	}
-	for (int i = 0; i < end - start + 1; ++i) {
-		MPI_Send(&C.mat[i][0], 1, MPI_LONG_DOUBLE, 0, i + start, MPI_COMM_WORLD);
-	}
-	return;
+};
+
+template < class T>
+Matrix <T> operator * (const Matrix_csr <T>& A, const Matrix <T>& b) {
+	Matrix < T > ret(A.n, b.getColSize());
+	if (b.getColSize() == 1) A.multiply(b.data(), ret.data());
+	else A.multiply_block(b.data(), ret.data(), b.getColSize());
+	return ret;
 }
-void vector_swap_MASTER(Matrix <long double>& A, Matrix <long double>& B, int n, int size, int op) {
-	int operation = op;
-	int subDivide = max((n / (size - 1)), 1);
-	int start = 0, end = start + subDivide;
-	for (int i = 1; i < size; ++i) {
-		if (i == size - 1) end = n - 1;
-		MPI_Send(&operation, 1, MPI_INT, i, 12345, MPI_COMM_WORLD);
-		MPI_Send(&start, 1, MPI_INT, i, 1e5, MPI_COMM_WORLD);
-		MPI_Send(&end, 1, MPI_INT, i, 2e5, MPI_COMM_WORLD);
-		for (int j = start; j <= end; j++) {
-			MPI_Send(&A.mat[j][0], 1, MPI_LONG_DOUBLE, i, j + 1e6, MPI_COMM_WORLD);
-		}
-		for (int j = start; j <= end; j++) {
-			MPI_Send(&B.mat[j][0], 1, MPI_LONG_DOUBLE, i, j + 2e6, MPI_COMM_WORLD);
-		}
-		start = end + 1;
-		end = min(n - 1, start + subDivide);
-	}
-	start = 0, end = start + subDivide;
-	for (int i = 1; i < size; ++i) {
-		if (i == size - 1) end = n - 1;
-		for (int j = start; j <= end; j++) {
-			MPI_Recv(&A.mat[j][0], 1, MPI_LONG_DOUBLE, i, j + 2e7, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-		}
-		for (int j = start; j <= end; j++) {
-			MPI_Recv(&B.mat[j][0], 1, MPI_LONG_DOUBLE, i, j + 1e7, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-		}
-		start = end + 1;
-		end = min(n - 1, start + subDivide);
+
+template < class T>
+Matrix_csr <T> operator * (const T& val, const Matrix_csr <T>& A) {
+	Matrix_csr < T > ret(A);
+	for (size_t i = 0; i < ret.val.size(); ++i) {
+		ret.val[i] *= val;
 	}
+	return ret;
 }
-void vector_swap(int rank) {
-	int n, start, end;
-	MPI_Recv(&start, 1, MPI_INT, 0, 1e5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	MPI_Recv(&end, 1, MPI_INT, 0, 2e5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	Matrix < long double > A(end - start + 1, 1), B(end - start + 1, 1);
-	for (int i = 0; i <= end - start; i++) {
-		MPI_Recv(&A.mat[i][0], 1, MPI_LONG_DOUBLE, 0, i + start + 1e6, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	}
-	for (int i = 0; i <= end - start; i++) {
-		MPI_Recv(&B.mat[i][0], 1, MPI_LONG_DOUBLE, 0, i + start + 2e6, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	}
-	for (int i = 0; i <= end - start; ++i) {
-		MPI_Send(&B.mat[i][0], 1, MPI_LONG_DOUBLE, 0, i + start + 2e7, MPI_COMM_WORLD);
-	}
-	for (int i = 0; i <= end - start; ++i) {
-		MPI_Send(&A.mat[i][0], 1, MPI_LONG_DOUBLE, 0, i + start + 1e7, MPI_COMM_WORLD);
+
+int map_to_int(int i, int j, int nx, int ny) {
+	if (i >= 0 && i < nx && j >= 0 && j < ny) {
+		return i * ny + j;
 	}
-	return;
+	return -1;
 }
-void vector_scalar_mult_MASTER(Matrix<long double>& C, Matrix <long double>& A, long double alpha, int n, int size, int op) {
-	int operation = op, subDivide = max((n / (size - 1)), 1), start = 0, end = start + subDivide;
-	for (int i = 1; i < size; ++i) {
-		if (i == size - 1) end = n - 1;
-		MPI_Send(&operation, 1, MPI_INT, i, 12345, MPI_COMM_WORLD);
-		MPI_Send(&start, 1, MPI_INT, i, 1e5, MPI_COMM_WORLD);
-		MPI_Send(&end, 1, MPI_INT, i, 2e5, MPI_COMM_WORLD);
-		MPI_Send(&alpha, 1, MPI_LONG_DOUBLE, i, 4e5, MPI_COMM_WORLD);
-		for (int j = start; j <= end; j++) {
-			MPI_Send(&A.mat[j][0], 1, MPI_LONG_DOUBLE, i, j + 1e6, MPI_COMM_WORLD);
-		}
-		start = end + 1;
-		end = min(n - 1, start + subDivide);
-	}
-	start = 0, end = start + subDivide;
-	for (int i = 1; i < size; ++i) {
-		if (i == size - 1) end = n - 1;
-		for (int j = start; j <= end; j++) {
-			MPI_Recv(&C.mat[j][0], 1, MPI_LONG_DOUBLE, i, j, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-		}
-		start = end + 1;
-		end = min(n - 1, start + subDivide);
+
+int dx[] = { -1, 0, 1, 0 };
+int dy[] = { 0, 1, 0, -1 };
+
+/*
+	matrix-free 5-point Laplacian on the nx x ny grid, unknown (i, j) is map_to_int(i, j)
+	(A x)(i, j) = center * x(i, j) + off * (sum of the 4 neighbours inside the grid)
+	nothing but the grid shape and the two coefficients is stored
+*/
+template <class T>
+class PoissonStencil {
+public:
+	int nx, ny;
+	T center, off;
+
+	PoissonStencil() {
+		nx = ny = 0;
+		center = 4, off = -1;
 	}
-}
-void vector_scalar_mult(int rank) {
-	int n, start, end;
-	long double alpha;
-	MPI_Recv(&start, 1, MPI_INT, 0, 1e5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	MPI_Recv(&end, 1, MPI_INT, 0, 2e5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	MPI_Recv(&alpha, 1, MPI_LONG_DOUBLE, 0, 4e5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	Matrix < long double > A(end - start + 1, 1), C(end - start + 1, 1);
-	for (int i = 0; i <= end - start; i++) {
-		MPI_Recv(&A.mat[i][0], 1, MPI_LONG_DOUBLE, 0, i + start + 1e6, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	PoissonStencil(int NX, int NY, T c = 4, T o = -1) {
+		nx = NX, ny = NY;
+		center = c, off = o;
 	}
-	for (int i = 0; i <= end - start; ++i) {
-		C.mat[i][0] = alpha * A.mat[i][0];
+	/* same operator in another precision */
+	template <class U>
+	explicit PoissonStencil(const PoissonStencil<U>& A) {
+		nx = A.nx, ny = A.ny;
+		center = A.center, off = A.off;
 	}
-	for (int i = 0; i <= end - start; ++i) {
-		MPI_Send(&C.mat[i][0], 1, MPI_LONG_DOUBLE, 0, i + start, MPI_COMM_WORLD);
+
+	size_t getRowSize() const { return (size_t)nx * ny; }
+	size_t getColSize() const { return (size_t)nx * ny; }
+
+	/* stencil at one grid point, neighbours outside the grid count as 0 */
+	T apply_point(const T* x, int i, int j) const {
+		T s = 0;
+		if (i > 0) s += x[(i - 1) * ny + j];
+		if (i < nx - 1) s += x[(i + 1) * ny + j];
+		if (j > 0) s += x[i * ny + j - 1];
+		if (j < ny - 1) s += x[i * ny + j + 1];
+		return center * x[i * ny + j] + off * s;
 	}
-	return;
-}
-long double vector_dot_MASTER(Matrix <long double>& A, Matrix<long double>& B, int n, int size, int op) {
-	int operation = op, subDivide = max((n / (size - 1)), 1), start = 0, end = start + subDivide;
-	for (int i = 1; i < size; ++i) {
-		if (i == size - 1) end = n - 1;
-		MPI_Send(&operation, 1, MPI_INT, i, 12345, MPI_COMM_WORLD);
-		MPI_Send(&start, 1, MPI_INT, i, 1e5, MPI_COMM_WORLD);
-		MPI_Send(&end, 1, MPI_INT, i, 2e5, MPI_COMM_WORLD);
-		for (int j = start; j <= end; j++) {
-			MPI_Send(&A.mat[j][0], 1, MPI_LONG_DOUBLE, i, j + 1e6, MPI_COMM_WORLD);
-		}
-		for (int j = start; j <= end; j++) {
-			MPI_Send(&B.mat[j][0], 1, MPI_LONG_DOUBLE, i, j + 2e6, MPI_COMM_WORLD);
+
+	/*
+		y = A * x over the whole grid
+		interior rows run the vector row kernel on columns 1 .. ny - 2, the
+		boundary points with missing neighbours go through apply_point
+	*/
+	void apply(const T* x, T* y) const {
+		OMP(omp parallel for if(run_parallel(getRowSize())) schedule(static))
+		for (int i = 0; i < nx; ++i) {
+			if (i == 0 || i == nx - 1 || ny < 3) {
+				for (int j = 0; j < ny; ++j) y[i * ny + j] = apply_point(x, i, j);
+				continue;
+			}
+			const T* mid = x + i * ny;
+			y[i * ny] = apply_point(x, i, 0);
+			stencil_row_kernel(mid - ny + 1, mid + 1, mid + ny + 1, center, off, y + i * ny + 1, ny - 2);
+			y[i * ny + ny - 1] = apply_point(x, i, ny - 1);
 		}
-		start = end + 1;
-		end = min(n - 1, start + subDivide);
 	}
-	long double dot = 0;
-	start = 0, end = start + subDivide;
-	for (int i = 1; i < size; ++i) {
-		if (i == size - 1) end = n - 1;
-		long double dot1;
-		MPI_Recv(&dot1, 1, MPI_LONG_DOUBLE, i, i * 10 + 123121, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-		dot += dot1;
-		start = end + 1;
-		end = min(n - 1, start + subDivide);
-	}
-	return dot;
-}
-void vector_dot(int rank) {
-	int n, start, end;
-	long double alpha;
-	MPI_Recv(&start, 1, MPI_INT, 0, 1e5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	MPI_Recv(&end, 1, MPI_INT, 0, 2e5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	Matrix < long double > A(end - start + 1, 1), B(end - start + 1, 1);
-	for (int i = 0; i <= end - start; i++) {
-		MPI_Recv(&A.mat[i][0], 1, MPI_LONG_DOUBLE, 0, i + start + 1e6, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	}
-	for (int i = 0; i <= end - start; i++) {
-		MPI_Recv(&B.mat[i][0], 1, MPI_LONG_DOUBLE, 0, i + start + 2e6, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	}
-	long double dot = 0;
-	for (int i = 0; i <= end - start; ++i) dot += A.mat[i][0] * B.mat[i][0];
-	MPI_Send(&dot, 1, MPI_LONG_DOUBLE, 0, rank * 10 + 123121, MPI_COMM_WORLD);
-	return;
-}
-void matrix_vector_mult_MASTER(Matrix <long double>& res, Matrix<int>& u, Matrix<long double>& b, int n, int dim, int size, int subDivide, int op) {
-	int num_threads = size * size, Lr = 0, Lc = 0, Rr = subDivide - 1, Rc = subDivide - 1, zero = -1;
-	for (int j = 0; j < n; ++j) {
-		res.mat[j][0] = 0.0;
-	}
-	for (int i = 1; i <= num_threads; ++i) {
-
-		MPI_Send(&op, 1, MPI_INT, i, 12345, MPI_COMM_WORLD);
-		MPI_Send(&Lr, 1, MPI_INT, i, 1e5, MPI_COMM_WORLD);
-		MPI_Send(&Lc, 1, MPI_INT, i, 2e5, MPI_COMM_WORLD);
-		MPI_Send(&Rr, 1, MPI_INT, i, 3e5, MPI_COMM_WORLD);
-		MPI_Send(&Rc, 1, MPI_INT, i, 4e5, MPI_COMM_WORLD);
-		MPI_Send(&n, 1, MPI_INT, i, 5e5, MPI_COMM_WORLD);
 
-		for (int j = Lr - 1; j <= Rr + 1; ++j) {
-			for (int k = Lc - 1; k <= Rc + 1; ++k) {
-				if (j >= 0 && j < dim && k >= 0 && k < dim) {
-					MPI_Send(&u.mat[j][k], 1, MPI_INT, i, 1e4 * (j + 1) + (k + 1), MPI_COMM_WORLD);
-				}
-				else {
-					MPI_Send(&zero, 1, MPI_INT, i, 1e4 * (j + 1) + (k + 1), MPI_COMM_WORLD);
+	/*
+		Y = A * X for k vectors stored row-major ((nx * ny) x k): one sweep over the
+		grid applies the stencil to the k contiguous values of every point
+	*/
+	void apply_block(const T* x, T* y, const size_t k) const {
+		/* a grid row is ny * k contiguous values, j -+ 1 sits k away and i -+ 1 ny * k away */
+		const size_t w = (size_t)ny * k;
+		const T c = center, o = off;
+		/* the calling thread's buffer, shared by the loop threads through z */
+		static thread_local vector < T > zero;
+		if (zero.size() < w) zero.assign(w, T(0));
+		const T* z = zero.data();
+		OMP(omp parallel for if(run_parallel(getRowSize() * k)) schedule(static))
+		for (int i = 0; i < nx; ++i) {
+			const T* __restrict mid = x + i * w;
+			const T* __restrict up = i > 0 ? mid - w : z;
+			const T* __restrict down = i < nx - 1 ? mid + w : z;
+			T* __restrict out = y + i * w;
+			for (size_t m = 0; m < w; ++m) {
+				if (m == k && w > 2 * k) {
+					OMP(omp simd)
+					for (size_t q = k; q < w - k; ++q) {
+						out[q] = c * mid[q] + o * (up[q] + down[q] + mid[q - k] + mid[q + k]);
+					}
+					m = w - k;
 				}
+				T s = up[m] + down[m];
+				if (m >= k) s += mid[m - k];
+				if (m + k < w) s += mid[m + k];
+				out[m] = c * mid[m] + o * s;
 			}
 		}
+	}
 
-		for (int j = 0; j < n; ++j) {
-			MPI_Send(&b.mat[j][0], 1, MPI_LONG_DOUBLE, i, 1e6 + j, MPI_COMM_WORLD);
-		}
-		Lc += subDivide;
-		Rc += subDivide;
-		if (Lc >= dim) {
-			Lc = 0;
-			Rc = subDivide - 1;
-			Lr += subDivide;
-			Rr += subDivide;
+	/*
+		y = A * x on a rows x cols block whose input g carries a one-cell ghost ring,
+		g is (rows + 2) x (cols + 2) row-major and y is rows x cols.
+		ghost cells outside the grid must hold 0
+	*/
+	void apply_ghosted(const T* g, int rows, int cols, T* y) const {
+		int w = cols + 2;
+		OMP(omp parallel for if(run_parallel((size_t)rows * cols)) schedule(static))
+		for (int i = 1; i <= rows; ++i) {
+			stencil_row_kernel(g + (i - 1) * w + 1, g + i * w + 1, g + (i + 1) * w + 1, center, off, y + (i - 1) * cols, cols);
 		}
 	}
 
-	long double gather = 0;
-	for (int i = 1; i <= num_threads; ++i) {
-		for (int j = 0; j < n; ++j) {
-			MPI_Recv(&gather, 1, MPI_LONG_DOUBLE, i, 1e8 + j, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-			res.mat[j][0] += gather;
+	/* explicit assembly, only for small grids and for checking other formats */
+	Matrix_coo<T> to_coo() const {
+		Matrix_coo<T> A(nx * ny, nx * ny);
+		for (int i = 0; i < nx; ++i) {
+			for (int j = 0; j < ny; ++j) {
+				int curr = map_to_int(i, j, nx, ny);
+				A.Insert_element(curr, curr, center);
+				for (int k = 0; k < 4; ++k) {
+					int r = map_to_int(i + dx[k], j + dy[k], nx, ny);
+					if (r != -1) A.Insert_element(curr, r, off);
+				}
+			}
 		}
+		return A;
 	}
+};
 
-	return;
+template <class T>
+Matrix <T> operator * (const PoissonStencil <T>& A, const Matrix <T>& x) {
+	assert(x.getRowSize() == A.getColSize());
+	Matrix <T> ret(A.getRowSize(), x.getColSize());
+	multiply(A, x, ret);
+	return ret;
 }
-void matrix_vector_mult(int rank) {
-	int Lr, Lc, Rr, Rc, n;
 
-	MPI_Recv(&Lr, 1, MPI_INT, 0, 1e5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	MPI_Recv(&Lc, 1, MPI_INT, 0, 2e5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	MPI_Recv(&Rr, 1, MPI_INT, 0, 3e5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	MPI_Recv(&Rc, 1, MPI_INT, 0, 4e5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	MPI_Recv(&n, 1, MPI_INT, 0, 5e5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+template <class T>
+PoissonStencil <T> operator * (const T& val, const PoissonStencil <T>& A) {
+	return PoissonStencil <T>(A.nx, A.ny, val * A.center, val * A.off);
+}
 
-	Matrix < int > u(Rr - Lr + 3, Rc - Lc + 3);
-	Matrix < long double > b(n, 1);
+/* copy of an operator in precision U, used by the mixed precision solvers */
+template <class U, class T>
+PoissonStencil <U> cast_operator(const PoissonStencil <T>& A) {
+	return PoissonStencil <U>(A);
+}
+template <class U, class T>
+Matrix_csr <U> cast_operator(const Matrix_csr <T>& A) {
+	return Matrix_csr <U>(A);
+}
 
-	for (int i = 0; i < Rr - Lr + 3; ++i) {
-		for (int j = 0; j < Rc - Lc + 3; ++j) {
-			MPI_Recv(&u.mat[i][j], 1, MPI_INT, 0, 1e4 * (Lr + i) + (Lc + j), MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-		}
-	}
-	for (int i = 0; i < n; ++i) {
-		MPI_Recv(&b.mat[i][0], 1, MPI_LONG_DOUBLE, 0, 1e6 + i, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	}
-	Matrix < long double > res(n, 1);
-	for (int i = 0; i < n; ++i) res.mat[i][0] = 0.0;
-	for (int i = 1; i <= Rr - Lr + 1; ++i) {
-		for (int j = 1; j <= Rc - Lc + 1; ++j) {
-			int curr_pos = u.mat[i][j];
-			res.mat[curr_pos][0] = 4.0 * b.mat[curr_pos][0];
-			if (u.mat[i - 1][j] >= 0) res.mat[curr_pos][0] -= b.mat[u.mat[i - 1][j]][0];
-			if (u.mat[i + 1][j] >= 0) res.mat[curr_pos][0] -= b.mat[u.mat[i + 1][j]][0];
-			if (u.mat[i][j - 1] >= 0) res.mat[curr_pos][0] -= b.mat[u.mat[i][j - 1]][0];
-			if (u.mat[i][j + 1] >= 0) res.mat[curr_pos][0] -= b.mat[u.mat[i][j + 1]][0];
-		}
+/*
+	y = A * x into a preallocated y, one overload per operator type
+	so the solvers can reuse their work vectors. the stencil and CSR forms
+	also take an n x k x, applied to all k columns in one sweep (SpMM)
+*/
+template <class T>
+void multiply(const PoissonStencil <T>& A, const Matrix <T>& x, Matrix <T>& y) {
+	PhaseTimer timer(PHASE_SPMV);
+	if (x.getColSize() == 1) A.apply(x.data(), y.data());
+	else A.apply_block(x.data(), y.data(), x.getColSize());
+}
+template <class T>
+void multiply(const Matrix_csr <T>& A, const Matrix <T>& x, Matrix <T>& y) {
+	PhaseTimer timer(PHASE_SPMV);
+	if (x.getColSize() == 1) A.multiply(x.data(), y.data());
+	else A.multiply_block(x.data(), y.data(), x.getColSize());
+}
+template <class T>
+void multiply(const Matrix_coo <T>& A, const Matrix <T>& x, Matrix <T>& y) {
+	PhaseTimer timer(PHASE_SPMV);
+	std::fill(y.data(), y.data() + y.size(), T(0));
+	for (int i = 0; i < A.size; ++i) {
+		y[A.row[i]] += A.val[i] * x[A.col[i]];
 	}
-	for (int i = 0; i < n; ++i) {
-		MPI_Send(&res.mat[i][0], 1, MPI_LONG_DOUBLE, 0, 1e8 + i, MPI_COMM_WORLD);
+}
+template <class T>
+void multiply(const Matrix <T>& A, const Matrix <T>& x, Matrix <T>& y) {
+	PhaseTimer timer(PHASE_SPMV);
+	OMP(omp parallel for if(run_parallel(A.size())) schedule(static))
+	for (size_t i = 0; i < A.getRowSize(); ++i) {
+		T s = 0;
+		for (size_t j = 0; j < A.getColSize(); ++j) s += A(i, j) * x[j];
+		y[i] = s;
 	}
-	return;
 }
 
-int main(int argc, char* argv[]) {
-
-	int rank, size;
-	MPI_Init(&argc, &argv);
-	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-	MPI_Comm_size(MPI_COMM_WORLD, &size);
+/* CSR copy of an operator, the form the preconditioners below are built from */
+template <class T>
+Matrix_csr <T> to_csr(const Matrix_csr <T>& A) {
+	return A;
+}
+template <class T>
+Matrix_csr <T> to_csr(const PoissonStencil <T>& A) {
+	return Matrix_csr <T>(A.to_coo());
+}
+template <class T>
+Matrix_csr <T> to_csr(const Matrix_coo <T>& A) {
+	return Matrix_csr <T>(A);
+}
 
-	if (rank == MASTER) {
-		auto t = generate_sparse_matrix(40, 40);
-		auto b = t.first; auto u = t.second;
+/*
+	preconditioners: z = M^-1 r through apply(r, z), with r and z preallocated n x 1
+	vectors. all of them are built from the CSR form of A (see to_csr) and are
+	symmetric positive definite for SPD A, so they can drive
+	preconditioned_conjugate_gradient directly
+*/
 
-		Matrix <long double> R0(b), R1(b.getRowSize(), 1);
-		Matrix <long double> P0(b), P1(b.getRowSize(), 1);
-		Matrix <long double> X0(b.getRowSize(), 1), X1(b.getRowSize(), 1);
-		Matrix <long double> temp(b.getRowSize(), 1), another_temp(b.getRowSize(), 1);
+/* an explicitly assembled M^-1, applied as a product (the old COO interface) */
+template <class Op>
+class OperatorPreconditioner {
+public:
+	Op B;
 
-		int True = 1, False = 0, itr = 0, row_size = 1, n = X0.getRowSize(), sq = u.getRowSize();
-		clock_t begin = clock();
-		cout << "..... Running Solver ....." << endl;
+	explicit OperatorPreconditioner(const Op& M) : B(M) {}
 
-		for (int i = 2; i * i <= sq; ++i) {
-			if (sq % i == 0 && i * i + 1 <= size) {
-				row_size = i;
-			}
-		}
+	template <class T>
+	void apply(const Matrix <T>& r, Matrix <T>& z) const {
+		multiply(B, r, z);
+	}
+};
 
-		while (sqrt(dot(R0, R0)) / sqrt(dot(b, b)) >= EPS) {
+/* M = diag(A) */
+template <class T>
+class JacobiPreconditioner {
+public:
+	vector < T > inv_diag;
 
-			for (int i = 1; i < size; ++i) {
-				MPI_Send(&True, 1, MPI_INT, i, 1234, MPI_COMM_WORLD);
+	explicit JacobiPreconditioner(const Matrix_csr <T>& A) {
+		inv_diag.assign(A.n, T(1));
+		for (int r = 0; r < A.n; ++r) {
+			for (int k = A.row_ptr[r]; k < A.row_ptr[r + 1]; ++k) {
+				if (A.col[k] == r && A.val[k] != 0) inv_diag[r] = T(1) / A.val[k];
 			}
-
-			++itr;
-			//cout << "#iteration: " << itr << endl;
-
-			// alpha = (trans(R0) * R0) / (trans(P0) * A * P0);
-			long double alpha = vector_dot_MASTER(R0, R0, n, size, 4);
-			matrix_vector_mult_MASTER(temp, u, P0, n, sq, row_size, sq / row_size, 5);
-			alpha /= vector_dot_MASTER(temp, P0, n, size, 4);
-
-			// X1 = X0 + alpha * P0; 
-			vector_scalar_mult_MASTER(temp, P0, alpha, n, size, 3);
-			vector_sum_MASTER(X1, X0, temp, n, size, 1);
-
-			// R1 = R0 - alpha * A * P0;
-			alpha *= -1.0;
-			matrix_vector_mult_MASTER(another_temp, u, P0, n, sq, row_size, sq / row_size, 5);
-			vector_scalar_mult_MASTER(temp, another_temp, alpha, n, size, 3);
-			vector_sum_MASTER(R1, R0, temp, n, size, 1);
-
-			// beta = (trans(R1) * R1) / (trans(R0) * R0);
-			long double beta = vector_dot_MASTER(R1, R1, n, size, 4) / vector_dot_MASTER(R0, R0, n, size, 4);
-
-			// P1 = R1 + beta * P0; 
-			vector_scalar_mult_MASTER(temp, P0, beta, n, size, 3);
-			vector_sum_MASTER(P1, R1, temp, n, size, 1);
-
-			// for the next iteration 
-			vector_swap_MASTER(R0, R1, n, size, 2);
-			vector_swap_MASTER(X0, X1, n, size, 2);
-			vector_swap_MASTER(P0, P1, n, size, 2);
 		}
+	}
 
-		for (int i = 1; i < size; ++i) {
-			MPI_Send(&False, 1, MPI_INT, i, 1234, MPI_COMM_WORLD);
+	void apply(const Matrix <T>& r, Matrix <T>& z) const {
+		OMP(omp parallel for if(run_parallel(r.size())) schedule(static))
+		for (size_t i = 0; i < r.size(); ++i) {
+			z[i] = inv_diag[i] * r[i];
 		}
+	}
+};
 
-		clock_t end = clock();
-		long double elapsed_secs = (long double)(end - begin) / CLOCKS_PER_SEC;
-		cout << "Time Elapsed: " << elapsed_secs << " sec" << endl;
-		cout << "Num. Iterations: " << itr << endl;
-		cout << "Error: " << dot(R0, R0) << endl;
+/*
+	M = block diagonal of A with contiguous blocks of block rows. every block is
+	factored once by banded Cholesky, the band being the widest coupling inside
+	the block, and the independent block solves of apply run in parallel.
+	with block = ny a block is one grid line of the Poisson problem, which is
+	tridiagonal, so setup and apply stay O(n)
+*/
+template <class T>
+class BlockJacobiPreconditioner {
+public:
+	int n, block;
+	/* band width and start of the factor of every block in L */
+	vector < int > band;
+	vector < size_t > offset;
+	/* row i of a block's lower factor holds columns i - band .. i */
+	vector < T > L;
+
+	BlockJacobiPreconditioner() {
+		n = 0, block = 1;
 	}
-	else {
-		int num_parallel_ops = 15;
-		int rank, operation, cont;
-		MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-
-		while (true) {
-			MPI_Recv(&cont, 1, MPI_INT, 0, 1234, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-			if (!cont) break;
-			for (int i = 1; i <= num_parallel_ops; ++i) {
-				MPI_Recv(&operation, 1, MPI_INT, 0, 12345, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-				if (operation == 1) {
-					vector_sum(rank);
-				}
-				else if (operation == 2) {
-					vector_swap(rank);
+	BlockJacobiPreconditioner(const Matrix_csr <T>& A, int block_size = 16) {
+		n = A.n, block = max(1, min(block_size, max(1, A.n)));
+		int blocks = (n + block - 1) / block;
+		band.assign(blocks, 0);
+		offset.assign(blocks + 1, 0);
+		for (int b = 0; b < blocks; ++b) {
+			int r0 = b * block, len = min(block, n - r0);
+			for (int r = r0; r < r0 + len; ++r) {
+				for (int k = A.row_ptr[r]; k < A.row_ptr[r + 1]; ++k) {
+					if (A.col[k] >= r0 && A.col[k] < r) band[b] = max(band[b], r - A.col[k]);
 				}
-				else if (operation == 3) {
-					vector_scalar_mult(rank);
-				}
-				else if (operation == 4) {
-					vector_dot(rank);
+			}
+			offset[b + 1] = offset[b] + (size_t)len * (band[b] + 1);
+		}
+		L.assign(offset[blocks], T(0));
+		OMP(omp parallel for if(run_parallel(n)) schedule(static))
+		for (int b = 0; b < blocks; ++b) {
+			int r0 = b * block, len = min(block, n - r0), w = band[b];
+			T* F = L.data() + offset[b];
+			auto at = [&](int i, int j) -> T& { return F[(size_t)i * (w + 1) + (j - i + w)]; };
+			for (int i = 0; i < len; ++i) {
+				int r = r0 + i;
+				for (int k = A.row_ptr[r]; k < A.row_ptr[r + 1]; ++k) {
+					int c = A.col[k] - r0;
+					if (c >= 0 && c <= i) at(i, c) = A.val[k];
 				}
-				else if (operation == 5) {
-					matrix_vector_mult(rank);
+			}
+			for (int j = 0; j < len; ++j) {
+				T d = at(j, j);
+				for (int k = max(0, j - w); k < j; ++k) d -= at(j, k) * at(j, k);
+				/* keeps the factor defined if the block is not SPD */
+				at(j, j) = d > 0 ? sqrt(d) : T(1);
+				for (int i = j + 1; i < min(len, j + w + 1); ++i) {
+					T s = at(i, j);
+					for (int k = max(0, i - w); k < j; ++k) s -= at(i, k) * at(j, k);
+					at(i, j) = s / at(j, j);
 				}
 			}
 		}
 	}
 
-	MPI_Finalize();
-	return 0;
-}
+	void apply(const Matrix <T>& r, Matrix <T>& z) const {
+		int blocks = (n + block - 1) / block;
+		OMP(omp parallel for if(run_parallel(r.size())) schedule(static))
+		for (int b = 0; b < blocks; ++b) {
+			int r0 = b * block, len = min(block, n - r0), w = band[b];
+			const T* F = L.data() + offset[b];
+			auto at = [&](int i, int j) { return F[(size_t)i * (w + 1) + (j - i + w)]; };
+			T* y = z.data() + r0;
+			for (int i = 0; i < len; ++i) {
+				T s = r[r0 + i];
+				for (int k = max(0, i - w); k < i; ++k) s -= at(i, k) * y[k];
+				y[i] = s / at(i, i);
+			}
+			for (int i = len - 1; i >= 0; --i) {
+				T s = y[i];
+				for (int k = i + 1; k < min(len, i + w + 1); ++k) s -= at(k, i) * y[k];
+				y[i] = s / at(i, i);
+			}
+		}
+	}
+};
 
+/*
+	SSOR with relaxation omega in (0, 2):
+	M = omega / (2 - omega) * (D / omega + L) (D / omega)^-1 (D / omega + U)
+	apply is one forward and one backward sweep, inherently sequential
+*/
 template <class T>
-T Adot(Matrix<T>& a, Matrix_coo<T>& A, Matrix<T>& b) {
-	Matrix <T> ret = trans(a) * (A * b);
-	return ret.mat[0][0];
-}
+class SsorPreconditioner {
+public:
+	Matrix_csr <T> A;
+	vector < T > diag;
+	T omega;
 
-template <class T>
-Matrix <T> conjugate_gradient(Matrix_coo <T>& A, Matrix <T>& b) {
-	clock_t begin = clock();
-	Matrix <T> R0(b.getRowSize(), 1), R1(b.getRowSize(), 1);
-	Matrix <T> P0(b.getRowSize(), 1), P1(b.getRowSize(), 1);
-	Matrix <T> X0(b.getRowSize(), 1), X1(b.getRowSize(), 1);
-	int itr = 0;
-	cout << "..... Running Normal Solver ....." << endl;
-	P0 = R0 = b - (A * X0);
-	while (sqrt(dot(R0, R0)) / sqrt(dot(b, b)) >= EPS) {
-		++itr;
-		T alpha = dot(R0, R0) / Adot(P0, A, P0);
-		X1 = X0 + alpha * P0;
-		R1 = R0 - alpha * A * P0;
-		T beta = dot(R1, R1) / dot(R0, R0);
-		P1 = R1 + beta * P0;
-		swap(R0, R1);
-		swap(X0, X1);
-		swap(P0, P1);
+	SsorPreconditioner(const Matrix_csr <T>& M, T w = 1.5) : A(M) {
+		omega = w;
+		diag.assign(A.n, T(1));
+		for (int r = 0; r < A.n; ++r) {
+			for (int k = A.row_ptr[r]; k < A.row_ptr[r + 1]; ++k) {
+				if (A.col[k] == r && A.val[k] != 0) diag[r] = A.val[k];
+			}
+		}
 	}
-	clock_t end = clock();
-	double elapsed_secs = double(end - begin) / CLOCKS_PER_SEC;
-	cout << "Time Elapsed: " << elapsed_secs << " sec" << endl;
-	cout << "Iterations: " << itr << endl;
-	cout << "Absolute Error: " << dot(b - A * X0, b - A * X0) << endl;
-	cout << endl;
-	return X0;
+
+	void apply(const Matrix <T>& r, Matrix <T>& z) const {
+		int n = A.n;
+		/* (D / omega + L) u = r */
+		for (int i = 0; i < n; ++i) {
+			T s = r[i];
+			for (int k = A.row_ptr[i]; k < A.row_ptr[i + 1] && A.col[k] < i; ++k) s -= A.val[k] * z[A.col[k]];
+			z[i] = s * omega / diag[i];
+		}
+		/* v = (2 - omega) / omega * (D / omega) u, then (D / omega + U) z = v */
+		T scale = (2 - omega) / (omega * omega);
+		for (int i = n - 1; i >= 0; --i) {
+			T s = scale * diag[i] * z[i];
+			for (int k = A.row_ptr[i + 1] - 1; k >= A.row_ptr[i] && A.col[k] > i; --k) s -= A.val[k] * z[A.col[k]];
+			z[i] = s * omega / diag[i];
+		}
+	}
+};
+
+/*
+	incomplete Cholesky IC(0): A ~ L L^T with L restricted to the lower triangle
+	pattern of A, stored as CSR rows with the diagonal last. a non-positive pivot
+	falls back to the diagonal of A so the factor stays defined
+*/
+template <class T>
+class IncompleteCholeskyPreconditioner {
+public:
+	Matrix_csr <T> L;
+
+	explicit IncompleteCholeskyPreconditioner(const Matrix_csr <T>& A) {
+		int n = A.n;
+		L.n = L.m = n;
+		L.row_ptr.assign(n + 1, 0);
+		for (int r = 0; r < n; ++r) {
+			for (int k = A.row_ptr[r]; k < A.row_ptr[r + 1] && A.col[k] <= r; ++k) {
+				L.col.push_back(A.col[k]);
+				L.val.push_back(A.val[k]);
+			}
+			/* a structurally missing diagonal still gets its slot */
+			if ((int)L.col.size() == L.row_ptr[r] || L.col.back() != r) {
+				L.col.push_back(r);
+				L.val.push_back(T(0));
+			}
+			L.row_ptr[r + 1] = L.col.size();
+		}
+		for (int i = 0; i < n; ++i) {
+			int di = L.row_ptr[i + 1] - 1;
+			for (int p = L.row_ptr[i]; p < di; ++p) {
+				/* L_ik -= sum over j < k of L_ij L_kj, merging the sorted rows i and k */
+				int k = L.col[p];
+				T s = L.val[p];
+				int a = L.row_ptr[i], b = L.row_ptr[k], dk = L.row_ptr[k + 1] - 1;
+				while (a < p && b < dk) {
+					if (L.col[a] == L.col[b]) s -= L.val[a++] * L.val[b++];
+					else if (L.col[a] < L.col[b]) ++a;
+					else ++b;
+				}
+				L.val[p] = s / L.val[dk];
+			}
+			T d = L.val[di];
+			for (int p = L.row_ptr[i]; p < di; ++p) d -= L.val[p] * L.val[p];
+			if (d <= 0) d = fabs(L.val[di]) > 0 ? fabs(L.val[di]) : T(1);
+			L.val[di] = sqrt(d);
+		}
+	}
+
+	void apply(const Matrix <T>& r, Matrix <T>& z) const {
+		int n = L.n;
+		/* L y = r */
+		for (int i = 0; i < n; ++i) {
+			T s = r[i];
+			int di = L.row_ptr[i + 1] - 1;
+			for (int p = L.row_ptr[i]; p < di; ++p) s -= L.val[p] * z[L.col[p]];
+			z[i] = s / L.val[di];
+		}
+		/* L^T z = y, column oriented over the rows of L */
+		for (int i = n - 1; i >= 0; --i) {
+			int di = L.row_ptr[i + 1] - 1;
+			z[i] /= L.val[di];
+			for (int p = L.row_ptr[i]; p < di; ++p) z[L.col[p]] -= L.val[p] * z[i];
+		}
+	}
+};
+
+/*
+	multicolor symmetric Gauss-Seidel: the rows are greedily coloured so no two
+	coupled rows share a colour (red-black for the 5-point stencil), then apply
+	runs one forward sweep over the colours and one backward sweep, starting from
+	z = 0. rows of one colour are independent and updated in parallel; the
+	forward/backward pair makes M symmetric, as CG needs
+*/
+template <class T>
+class MulticolorGaussSeidelPreconditioner {
+public:
+	Matrix_csr <T> A;
+	vector < T > diag;
+	/* rows of colour c are order[color_ptr[c] .. color_ptr[c + 1]) */
+	vector < int > order, color_ptr;
+
+	explicit MulticolorGaussSeidelPreconditioner(const Matrix_csr <T>& M) : A(M) {
+		int n = A.n, colors = 0;
+		diag.assign(n, T(1));
+		vector < int > color(n, -1), mark;
+		for (int r = 0; r < n; ++r) {
+			for (int k = A.row_ptr[r]; k < A.row_ptr[r + 1]; ++k) {
+				if (A.col[k] == r && A.val[k] != 0) diag[r] = A.val[k];
+				else if (A.col[k] < r) {
+					int c = color[A.col[k]];
+					if (c >= (int)mark.size()) mark.resize(c + 1, -1);
+					mark[c] = r;
+				}
+			}
+			int c = 0;
+			while (c < (int)mark.size() && mark[c] == r) ++c;
+			color[r] = c;
+			colors = max(colors, c + 1);
+		}
+		color_ptr.assign(colors + 1, 0);
+		for (int r = 0; r < n; ++r) color_ptr[color[r] + 1]++;
+		for (int c = 0; c < colors; ++c) color_ptr[c + 1] += color_ptr[c];
+		vector < int > next(color_ptr.begin(), color_ptr.end() - 1);
+		order.resize(n);
+		for (int r = 0; r < n; ++r) order[next[color[r]]++] = r;
+	}
+
+	int colors() const { return (int)color_ptr.size() - 1; }
+
+	void apply(const Matrix <T>& r, Matrix <T>& z) const {
+		std::fill(z.data(), z.data() + z.size(), T(0));
+		for (int c = 0; c < colors(); ++c) sweep(c, r, z);
+		for (int c = colors() - 1; c >= 0; --c) sweep(c, r, z);
+	}
+
+private:
+	/* z_i = (r_i - sum over j != i of a_ij z_j) / a_ii for every row i of colour c */
+	void sweep(int c, const Matrix <T>& r, Matrix <T>& z) const {
+		int begin = color_ptr[c], end = color_ptr[c + 1];
+		OMP(omp parallel for if(run_parallel(end - begin)) schedule(static))
+		for (int t = begin; t < end; ++t) {
+			int i = order[t];
+			T s = r[i];
+			for (int k = A.row_ptr[i]; k < A.row_ptr[i + 1]; ++k) {
+				if (A.col[k] != i) s -= A.val[k] * z[A.col[k]];
+			}
+			z[i] = s / diag[i];
+		}
+	}
+};
+
+/*
+	grid transfers between a fine nx x ny grid and its (nx - 1) / 2 x (ny - 1) / 2
+	coarse grid, coarse point (I, J) sitting on fine point (2I + 1, 2J + 1)
+*/
+/* coarse points interpolating fine index i: odd i lies on (i - 1) / 2, even i between i / 2 - 1 and i / 2 */
+template <class T>
+int coarse_neighbours(int i, int nc, int* I, T* w) {
+	if (i % 2) {
+		I[0] = (i - 1) / 2, w[0] = 1;
+		return I[0] < nc ? 1 : 0;
+	}
+	int k = 0;
+	if (i / 2 - 1 >= 0 && i / 2 - 1 < nc) I[k] = i / 2 - 1, w[k++] = T(0.5);
+	if (i / 2 < nc) I[k] = i / 2, w[k++] = T(0.5);
+	return k;
+}
+
+/*
+	full weighting, c(I, J) = 1/16 [1 2 1; 2 4 2; 1 2 1] around fine (2I + 1, 2J + 1),
+	for the coarse rows [I0, I1) and columns [J0, J1) into c row-major.
+	fine point (i, j) is read at f[(i - fi0) * stride + j - fj0]; every point read
+	lies inside the fine grid
+*/
+template <class T>
+void restrict_full_weighting(const T* f, int stride, int fi0, int fj0, int I0, int I1, int J0, int J1, T* c) {
+	int w = J1 - J0;
+	OMP(omp parallel for if(run_parallel((size_t)max(0, I1 - I0) * max(0, w))) schedule(static))
+	for (int I = I0; I < I1; ++I) {
+		const T* up = f + (2 * I - fi0) * stride - fj0;
+		const T* mid = up + stride;
+		const T* down = mid + stride;
+		for (int J = J0; J < J1; ++J) {
+			int j = 2 * J + 1;
+			c[(I - I0) * w + J - J0] = (4 * mid[j] + 2 * (mid[j - 1] + mid[j + 1] + up[j] + down[j])
+				+ up[j - 1] + up[j + 1] + down[j - 1] + down[j + 1]) / 16;
+		}
+	}
+}
+
+/*
+	bilinear interpolation of the cx x cy coarse grid c, added onto the fine
+	rows [fi0, fi1) and columns [fj0, fj1) stored row-major in f. this is 4 times
+	the transpose of full weighting, which keeps the V-cycle symmetric.
+	coarse point (I, J) is read at c[(I - ci0) * stride + J - cj0], so c may be a
+	ghosted block of the coarse grid holding every point the fine block needs
+*/
+template <class T>
+void prolong_bilinear_add(const T* c, int stride, int ci0, int cj0, int cx, int cy, int fi0, int fi1, int fj0, int fj1, T* f) {
+	int w = fj1 - fj0;
+	OMP(omp parallel for if(run_parallel((size_t)max(0, fi1 - fi0) * max(0, w))) schedule(static))
+	for (int i = fi0; i < fi1; ++i) {
+		int I[2], J[2];
+		T wi[2], wj[2];
+		int ni = coarse_neighbours(i, cx, I, wi);
+		for (int j = fj0; j < fj1; ++j) {
+			int nj = coarse_neighbours(j, cy, J, wj);
+			T s = 0;
+			for (int a = 0; a < ni; ++a) {
+				for (int b = 0; b < nj; ++b) s += wi[a] * wj[b] * c[(I[a] - ci0) * stride + J[b] - cj0];
+			}
+			f[(i - fi0) * w + j - fj0] += s;
+		}
+	}
+}
+
+/* coarsening stops once a grid has this few points or a side shorter than 3 */
+const int MG_COARSE_SIZE = 64;
+
+/*
+	geometric multigrid V-cycle on the structured Poisson grid as a preconditioner:
+	damped Jacobi smoothing (sweeps before and after), full weighting restriction,
+	bilinear prolongation and an exact banded Cholesky solve on the coarsest grid.
+	the coarse operators are rediscretised: the unscaled 5-point stencil of the
+	grid with spacing 2h is the fine one divided by 4. the pre and post smoothing
+	mirror each other so M is symmetric and one V-cycle per CG iteration keeps the
+	iteration count nearly independent of the grid size
+*/
+template <class T>
+class MultigridPreconditioner {
+public:
+	/* levels[0] is the fine operator, levels.back() the coarsest */
+	vector < PoissonStencil <T> > levels;
+	int sweeps;
+	T omega;
+
+	MultigridPreconditioner() {
+		sweeps = 0, omega = 0;
+	}
+	MultigridPreconditioner(const PoissonStencil <T>& A, int nu = 2, T w = 0.8) {
+		sweeps = nu, omega = w;
+		levels.push_back(A);
+		while (min(levels.back().nx, levels.back().ny) >= 3 && levels.back().nx * levels.back().ny > MG_COARSE_SIZE) {
+			const PoissonStencil <T>& F = levels.back();
+			levels.push_back(PoissonStencil <T>((F.nx - 1) / 2, (F.ny - 1) / 2, F.center / 4, F.off / 4));
+		}
+		for (size_t l = 0; l < levels.size(); ++l) {
+			size_t n = levels[l].getRowSize();
+			x.push_back(Matrix <T>(n, 1));
+			b.push_back(Matrix <T>(n, 1));
+			r.push_back(Matrix <T>(n, 1));
+		}
+		const PoissonStencil <T>& C = levels.back();
+		coarse = BlockJacobiPreconditioner <T>(to_csr(C), C.nx * C.ny);
+	}
+
+	void apply(const Matrix <T>& rhs, Matrix <T>& z) const {
+		vcycle(0, rhs, z);
+	}
+
+private:
+	/* per level work vectors: solution, right-hand side, residual */
+	mutable vector < Matrix <T> > x, b, r;
+	/* one block covering the coarsest grid, i.e. its exact Cholesky factor */
+	BlockJacobiPreconditioner <T> coarse;
+
+	/* sweeps of x += omega / center (rhs - A x), the first one starting from x = 0 */
+	void smooth(int l, const Matrix <T>& rhs, Matrix <T>& u, bool from_zero) const {
+		const PoissonStencil <T>& S = levels[l];
+		T w = omega / S.center;
+		size_t n = S.getRowSize();
+		for (int k = 0; k < sweeps; ++k) {
+			if (k == 0 && from_zero) {
+				for (size_t i = 0; i < n; ++i) u[i] = w * rhs[i];
+				continue;
+			}
+			S.apply(u.data(), r[l].data());
+			for (size_t i = 0; i < n; ++i) u[i] += w * (rhs[i] - r[l][i]);
+		}
+		if (sweeps == 0 && from_zero) std::fill(u.data(), u.data() + n, T(0));
+	}
+
+	void vcycle(size_t l, const Matrix <T>& rhs, Matrix <T>& u) const {
+		if (l + 1 == levels.size()) {
+			coarse.apply(rhs, u);
+			return;
+		}
+		const PoissonStencil <T>& F = levels[l];
+		const PoissonStencil <T>& C = levels[l + 1];
+		size_t n = F.getRowSize();
+		smooth(l, rhs, u, true);
+		F.apply(u.data(), r[l].data());
+		for (size_t i = 0; i < n; ++i) r[l][i] = rhs[i] - r[l][i];
+		restrict_full_weighting(r[l].data(), F.ny, 0, 0, 0, C.nx, 0, C.ny, b[l + 1].data());
+		vcycle(l + 1, b[l + 1], x[l + 1]);
+		prolong_bilinear_add(x[l + 1].data(), C.ny, 0, 0, C.nx, C.ny, 0, F.nx, 0, F.ny, u.data());
+		smooth(l, rhs, u, false);
+	}
+};
+
+/* entries of b drawn uniformly from [0, val_mx), the same ones for the same seed */
+template <class T>
+void fill_random(Matrix <T>& b, unsigned seed = RHS_SEED) {
+	std::mt19937 gen(seed);
+	for (size_t i = 0; i < b.size(); ++i) {
+		b[i] = (gen() % val_mx) * 1.0;
+	}
+}
+
+template <class T = long double>
+pair <Matrix <T>, Matrix <T>> generate_dense_matrix(int nx_max, int ny_max, unsigned seed = RHS_SEED) {
+	int nx = nx_max;
+	int ny = ny_max;
+	Matrix < T > b(nx * ny, 1);
+	fill_random(b, seed);
+	Matrix < T > A(nx * ny, nx * ny);
+	Matrix_coo < T > S = PoissonStencil < T >(nx, ny, -4, 1).to_coo();
+	for (int i = 0; i < S.size; ++i) {
+		A(S.row[i], S.col[i]) = S.val[i];
+	}
+	return { A, b };
+}
+/* right-hand side plus the matrix-free operator of the nx x ny problem */
+template <class T = long double>
+pair <Matrix <T>, PoissonStencil <T> > generate_sparse_matrix(int nx_max, int ny_max, unsigned seed = RHS_SEED) {
+	int nx = nx_max;
+	int ny = ny_max;
+	Matrix < T > b(nx * ny, 1);
+	fill_random(b, seed);
+	return { b, PoissonStencil < T >(nx, ny) };
+}
+
+/*
+	file input and output. Matrix Market (.mtx) is the exchange format: coordinate
+	matrices (real, integer or pattern; general or symmetric) and array vectors.
+	the binary format is for production runs: a 64-byte BinaryHeader followed by the
+	arrays, each section starting on a BINARY_ALIGN boundary, so a mapping of the file
+	can be used in place (CsrView) and a rank can read just its rows (DistributedCsr).
+	csr: row_ptr as int64 [rows + 1], col as int32 [nnz], val [nnz]
+	vector: val [rows]
+	failures print what went wrong and return false
+*/
+const size_t BINARY_ALIGN = 64;
+const char BINARY_CSR_MAGIC[8] = { 'C', 'G', 'C', 'S', 'R', '0', '1', 0 };
+const char BINARY_VECTOR_MAGIC[8] = { 'C', 'G', 'V', 'E', 'C', '0', '1', 0 };
+/* written as 1, reads back as something else on a machine of the other byte order */
+const int32_t BINARY_BYTE_ORDER = 1;
+
+struct BinaryHeader {
+	char magic[8];
+	int32_t byte_order, scalar_size;
+	int64_t rows, cols, nnz;
+	char reserved[24];
+};
+static_assert(sizeof(BinaryHeader) == BINARY_ALIGN, "binary header is one aligned block");
+
+inline size_t binary_align(size_t offset) {
+	return (offset + BINARY_ALIGN - 1) / BINARY_ALIGN * BINARY_ALIGN;
+}
+
+/* byte offsets of the row_ptr, col and val sections of a binary csr file */
+struct CsrSections {
+	size_t row_ptr, col, val, end;
+};
+
+inline CsrSections csr_sections(const BinaryHeader& h) {
+	CsrSections s;
+	s.row_ptr = sizeof(BinaryHeader);
+	s.col = binary_align(s.row_ptr + (h.rows + 1) * sizeof(int64_t));
+	s.val = binary_align(s.col + h.nnz * sizeof(int32_t));
+	s.end = s.val + h.nnz * h.scalar_size;
+	return s;
+}
+
+inline bool has_extension(const string& path, const string& ext) {
+	return path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+/* header of a binary file of the given kind, checked for magic, byte order and scalar size */
+inline bool check_header(const BinaryHeader& h, const char* magic, const string& path) {
+	if (memcmp(h.magic, magic, sizeof(h.magic)) != 0) {
+		cout << path << ": not a " << magic << " file" << endl;
+		return false;
+	}
+	if (h.byte_order != BINARY_BYTE_ORDER) {
+		cout << path << ": written with the other byte order" << endl;
+		return false;
+	}
+	if (h.scalar_size != sizeof(float) && h.scalar_size != sizeof(double) && h.scalar_size != sizeof(long double)) {
+		cout << path << ": unknown scalar size " << h.scalar_size << endl;
+		return false;
+	}
+	/* int32 columns and int grid indices; the nnz bound keeps the section offsets from overflowing */
+	if (h.rows < 0 || h.rows > INT_MAX || h.cols < 0 || h.cols > INT_MAX || h.nnz < 0 || h.nnz > INT64_MAX / 64) {
+		cout << path << ": bad sizes " << h.rows << " x " << h.cols << ", " << h.nnz << " entries" << endl;
+		return false;
+	}
+	return true;
+}
+
+/*
+	rows + 1 row_ptr entries of a csr file (all of them, or a rank's slice) must not
+	decrease and stay within [0, nnz]; the full array also runs from 0 to nnz.
+	checked before anything indexes with them
+*/
+inline bool check_row_ptr(const int64_t* row_ptr, int64_t rows, int64_t nnz, bool from_start, bool to_end, const string& path) {
+	bool ok = row_ptr[0] >= 0 && row_ptr[rows] <= nnz && (!from_start || row_ptr[0] == 0) && (!to_end || row_ptr[rows] == nnz);
+	for (int64_t r = 0; ok && r < rows; ++r) ok = row_ptr[r] <= row_ptr[r + 1];
+	if (!ok) cout << path << ": corrupt row_ptr" << endl;
+	return ok;
+}
+
+/* every one of count column indices lies in [0, cols) */
+inline bool check_columns(const int32_t* col, int64_t count, int64_t cols, const string& path) {
+	for (int64_t k = 0; k < count; ++k) {
+		if (col[k] < 0 || col[k] >= cols) {
+			cout << path << ": column index " << col[k] << " out of range" << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/* count scalars of scalar_size bytes (float, double or long double) converted to T */
+template <class T>
+void convert_scalars(const char* raw, int scalar_size, T* out, size_t count) {
+	if (scalar_size == sizeof(T)) memcpy(out, raw, count * sizeof(T));
+	else if (scalar_size == sizeof(float)) for (size_t i = 0; i < count; ++i) out[i] = ((const float*)raw)[i];
+	else if (scalar_size == sizeof(double)) for (size_t i = 0; i < count; ++i) out[i] = ((const double*)raw)[i];
+	else for (size_t i = 0; i < count; ++i) out[i] = ((const long double*)raw)[i];
+}
+
+/*
+	read-only view of a whole file: mmap where the platform has it, so pages are only
+	read when touched, otherwise one read into an owned buffer
+*/
+class MappedFile {
+public:
+	const char* data = nullptr;
+	size_t size = 0;
+
+	MappedFile() {}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator = (const MappedFile&) = delete;
+	MappedFile(MappedFile&& o) noexcept { *this = std::move(o); }
+	MappedFile& operator = (MappedFile&& o) noexcept {
+		if (this != &o) {
+			close();
+			data = o.data, size = o.size, mapped = o.mapped;
+			buffer = std::move(o.buffer);
+			if (!mapped) data = buffer.data();
+			o.data = nullptr, o.size = 0, o.mapped = false;
+		}
+		return *this;
+	}
+	~MappedFile() { close(); }
+
+	bool open(const string& path) {
+		close();
+#ifdef HAVE_MMAP
+		int fd = ::open(path.c_str(), O_RDONLY);
+		struct stat st;
+		if (fd < 0 || fstat(fd, &st) != 0) {
+			if (fd >= 0) ::close(fd);
+			cout << path << ": cannot open" << endl;
+			return false;
+		}
+		size = st.st_size;
+		void* p = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		::close(fd);
+		if (p != MAP_FAILED) {
+			data = (const char*)p, mapped = true;
+			return true;
+		}
+#endif
+		FILE* f = fopen(path.c_str(), "rb");
+		if (!f) {
+			cout << path << ": cannot open" << endl;
+			return false;
+		}
+		fseek(f, 0, SEEK_END);
+		buffer.resize(ftell(f));
+		fseek(f, 0, SEEK_SET);
+		size_t got = fread(buffer.data(), 1, buffer.size(), f);
+		fclose(f);
+		data = buffer.data(), size = got;
+		return got == buffer.size();
+	}
+
+	void close() {
+#ifdef HAVE_MMAP
+		if (mapped) munmap((void*)data, size);
+#endif
+		buffer.clear();
+		data = nullptr, size = 0, mapped = false;
+	}
+
+private:
+	vector < char > buffer;
+	bool mapped = false;
+};
+
+/*
+	zero-copy csr operator on a mapped binary file: the arrays are used where they
+	lie in the mapping, nothing is copied or converted, so T must match the scalar
+	size of the file. supports multiply(), so every serial solver takes it
+*/
+template <class T>
+class CsrView {
+public:
+	MappedFile file;
+	int64_t n = 0, m = 0, entries = 0;
+	const int64_t* row_ptr = nullptr;
+	const int32_t* col = nullptr;
+	const T* val = nullptr;
+
+	bool open(const string& path) {
+		if (!file.open(path)) return false;
+		BinaryHeader h;
+		if (file.size < sizeof(h)) {
+			cout << path << ": truncated" << endl;
+			return false;
+		}
+		memcpy(&h, file.data, sizeof(h));
+		if (!check_header(h, BINARY_CSR_MAGIC, path)) return false;
+		if (h.scalar_size != sizeof(T)) {
+			cout << path << ": holds " << h.scalar_size << "-byte scalars, a view needs " << sizeof(T) << endl;
+			return false;
+		}
+		CsrSections s = csr_sections(h);
+		if (file.size < s.end) {
+			cout << path << ": truncated" << endl;
+			return false;
+		}
+		const int64_t* rp = (const int64_t*)(file.data + s.row_ptr);
+		const int32_t* c = (const int32_t*)(file.data + s.col);
+		if (!check_row_ptr(rp, h.rows, h.nnz, true, true, path) || !check_columns(c, h.nnz, h.cols, path)) return false;
+		n = h.rows, m = h.cols, entries = h.nnz;
+		row_ptr = rp, col = c;
+		val = (const T*)(file.data + s.val);
+		return true;
+	}
+
+	size_t getRowSize() const { return n; }
+	size_t getColSize() const { return m; }
+	size_t nnz() const { return entries; }
+
+	void multiply(const T* x, T* y) const {
+		OMP(omp parallel for if(run_parallel(nnz())) schedule(static))
+		for (int64_t r = 0; r < n; ++r) {
+			T s = 0;
+			for (int64_t k = row_ptr[r]; k < row_ptr[r + 1]; ++k) {
+				s += val[k] * x[col[k]];
+			}
+			y[r] = s;
+		}
+	}
+};
+
+template <class T>
+void multiply(const CsrView <T>& A, const Matrix <T>& x, Matrix <T>& y) {
+	PhaseTimer timer(PHASE_SPMV);
+	A.multiply(x.data(), y.data());
+}
+
+/* Matrix Market banner and size line; rows/cols/entries as listed in the file */
+struct MatrixMarketInfo {
+	bool coordinate = true, pattern = false, symmetric = false;
+	long long rows = 0, cols = 0, entries = 0;
+};
+
+inline bool read_matrix_market_header(FILE* f, const string& path, MatrixMarketInfo& info) {
+	char line[1024], object[64], format[64], field[64], symmetry[64];
+	if (!fgets(line, sizeof(line), f) || sscanf(line, "%%%%MatrixMarket %63s %63s %63s %63s", object, format, field, symmetry) != 4) {
+		cout << path << ": missing %%MatrixMarket banner" << endl;
+		return false;
+	}
+	string fmt = format, fld = field, sym = symmetry;
+	for (auto* str : { &fmt, &fld, &sym }) transform(str->begin(), str->end(), str->begin(), ::tolower);
+	info.coordinate = fmt == "coordinate";
+	info.pattern = fld == "pattern";
+	info.symmetric = sym == "symmetric";
+	if ((fmt != "coordinate" && fmt != "array") || fld == "complex" || (sym != "general" && sym != "symmetric")) {
+		cout << path << ": unsupported Matrix Market type " << format << " " << field << " " << symmetry << endl;
+		return false;
+	}
+	do {
+		if (!fgets(line, sizeof(line), f)) {
+			cout << path << ": missing size line" << endl;
+			return false;
+		}
+	} while (line[0] == '%' || line[strspn(line, " \t\r\n")] == 0);
+	int got = info.coordinate ? sscanf(line, "%lld %lld %lld", &info.rows, &info.cols, &info.entries)
+		: sscanf(line, "%lld %lld", &info.rows, &info.cols);
+	if (got != (info.coordinate ? 3 : 2)) {
+		cout << path << ": bad size line" << endl;
+		return false;
+	}
+	if (!info.coordinate) info.entries = info.rows * info.cols;
+	return true;
+}
+
+/* coordinate Matrix Market file into A, a symmetric file gets both triangles */
+template <class T>
+bool read_matrix_market(const string& path, Matrix_coo <T>& A) {
+	FILE* f = fopen(path.c_str(), "r");
+	if (!f) {
+		cout << path << ": cannot open" << endl;
+		return false;
+	}
+	MatrixMarketInfo info;
+	bool ok = read_matrix_market_header(f, path, info);
+	if (ok && !info.coordinate) {
+		cout << path << ": a matrix needs the coordinate format" << endl;
+		ok = false;
+	}
+	if (ok) {
+		A = Matrix_coo <T>(info.rows, info.cols);
+		char line[1024];
+		for (long long e = 0; e < info.entries && ok; ++e) {
+			long long i, j;
+			long double v = 1;
+			if (!fgets(line, sizeof(line), f)) ok = false;
+			else if (line[0] == '%') --e;
+			else if (sscanf(line, "%lld %lld %Lg", &i, &j, &v) < (info.pattern ? 2 : 3) || i < 1 || j < 1 || i > info.rows || j > info.cols) ok = false;
+			else {
+				A.Insert_element(i - 1, j - 1, T(v));
+				if (info.symmetric && i != j) A.Insert_element(j - 1, i - 1, T(v));
+			}
+		}
+		if (!ok) cout << path << ": bad or missing entry" << endl;
+	}
+	fclose(f);
+	return ok;
+}
+
+/* array Matrix Market file (one column) into b */
+template <class T>
+bool read_matrix_market(const string& path, Matrix <T>& b) {
+	FILE* f = fopen(path.c_str(), "r");
+	if (!f) {
+		cout << path << ": cannot open" << endl;
+		return false;
+	}
+	MatrixMarketInfo info;
+	bool ok = read_matrix_market_header(f, path, info);
+	if (ok && (info.coordinate || info.cols != 1)) {
+		cout << path << ": a vector needs the array format with one column" << endl;
+		ok = false;
+	}
+	if (ok) {
+		b = Matrix <T>(info.rows, 1);
+		for (long long i = 0; i < info.rows && ok; ++i) {
+			long double v;
+			ok = fscanf(f, " %Lg", &v) == 1;
+			b[i] = v;
+		}
+		if (!ok) cout << path << ": bad or missing entry" << endl;
+	}
+	fclose(f);
+	return ok;
+}
+
+/* A as a coordinate real general Matrix Market file, at full precision */
+template <class T>
+bool write_matrix_market(const string& path, const Matrix_csr <T>& A) {
+	FILE* f = fopen(path.c_str(), "w");
+	if (!f) {
+		cout << path << ": cannot create" << endl;
+		return false;
+	}
+	fprintf(f, "%%%%MatrixMarket matrix coordinate real general\n%d %d %zu\n", A.n, A.m, A.nnz());
+	for (int r = 0; r < A.n; ++r) {
+		for (int k = A.row_ptr[r]; k < A.row_ptr[r + 1]; ++k) {
+			fprintf(f, "%d %d %.*Lg\n", r + 1, A.col[k] + 1, numeric_limits<T>::max_digits10, (long double)A.val[k]);
+		}
+	}
+	return fclose(f) == 0;
+}
+
+/* b as an array Matrix Market file */
+template <class T>
+bool write_matrix_market(const string& path, const Matrix <T>& b) {
+	FILE* f = fopen(path.c_str(), "w");
+	if (!f) {
+		cout << path << ": cannot create" << endl;
+		return false;
+	}
+	fprintf(f, "%%%%MatrixMarket matrix array real general\n%zu 1\n", b.size());
+	for (size_t i = 0; i < b.size(); ++i) {
+		fprintf(f, "%.*Lg\n", numeric_limits<T>::max_digits10, (long double)b[i]);
+	}
+	return fclose(f) == 0;
+}
+
+/* zero padding up to the next BINARY_ALIGN boundary */
+inline void binary_pad(FILE* f) {
+	static const char zeros[BINARY_ALIGN] = {};
+	long at = ftell(f);
+	fwrite(zeros, 1, binary_align(at) - at, f);
+}
+
+inline BinaryHeader binary_header(const char* magic, int scalar_size, int64_t rows, int64_t cols, int64_t nnz) {
+	BinaryHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, magic, sizeof(h.magic));
+	h.byte_order = BINARY_BYTE_ORDER, h.scalar_size = scalar_size;
+	h.rows = rows, h.cols = cols, h.nnz = nnz;
+	return h;
+}
+
+/* A in the binary csr format, scalars of type T */
+template <class T>
+bool write_binary(const string& path, const Matrix_csr <T>& A) {
+	FILE* f = fopen(path.c_str(), "wb");
+	if (!f) {
+		cout << path << ": cannot create" << endl;
+		return false;
+	}
+	BinaryHeader h = binary_header(BINARY_CSR_MAGIC, sizeof(T), A.n, A.m, A.nnz());
+	vector < int64_t > row_ptr(A.row_ptr.begin(), A.row_ptr.end());
+	fwrite(&h, sizeof(h), 1, f);
+	fwrite(row_ptr.data(), sizeof(int64_t), row_ptr.size(), f);
+	binary_pad(f);
+	fwrite(A.col.data(), sizeof(int32_t), A.col.size(), f);
+	binary_pad(f);
+	fwrite(A.val.data(), sizeof(T), A.val.size(), f);
+	return fclose(f) == 0;
+}
+
+/* b in the binary vector format */
+template <class T>
+bool write_binary(const string& path, const Matrix <T>& b) {
+	FILE* f = fopen(path.c_str(), "wb");
+	if (!f) {
+		cout << path << ": cannot create" << endl;
+		return false;
+	}
+	BinaryHeader h = binary_header(BINARY_VECTOR_MAGIC, sizeof(T), b.size(), 1, b.size());
+	fwrite(&h, sizeof(h), 1, f);
+	fwrite(b.data(), sizeof(T), b.size(), f);
+	return fclose(f) == 0;
+}
+
+/* binary csr file into A, converting the scalars to T when the file holds another type */
+template <class T>
+bool read_binary(const string& path, Matrix_csr <T>& A) {
+	MappedFile file;
+	if (!file.open(path)) return false;
+	BinaryHeader h;
+	if (file.size < sizeof(h)) {
+		cout << path << ": truncated" << endl;
+		return false;
+	}
+	memcpy(&h, file.data, sizeof(h));
+	if (!check_header(h, BINARY_CSR_MAGIC, path)) return false;
+	if (h.nnz > INT_MAX) {
+		cout << path << ": " << h.nnz << " entries, more than the int row_ptr of Matrix_csr holds" << endl;
+		return false;
+	}
+	CsrSections s = csr_sections(h);
+	if (file.size < s.end) {
+		cout << path << ": truncated" << endl;
+		return false;
+	}
+	const int64_t* row_ptr = (const int64_t*)(file.data + s.row_ptr);
+	const int32_t* col = (const int32_t*)(file.data + s.col);
+	if (!check_row_ptr(row_ptr, h.rows, h.nnz, true, true, path) || !check_columns(col, h.nnz, h.cols, path)) return false;
+	A.n = h.rows, A.m = h.cols;
+	A.row_ptr.assign(row_ptr, row_ptr + h.rows + 1);
+	A.col.assign(col, col + h.nnz);
+	A.val.resize(h.nnz);
+	convert_scalars(file.data + s.val, h.scalar_size, A.val.data(), h.nnz);
+	return true;
+}
+
+/* binary vector file into b */
+template <class T>
+bool read_binary(const string& path, Matrix <T>& b) {
+	MappedFile file;
+	if (!file.open(path)) return false;
+	BinaryHeader h;
+	if (file.size < sizeof(h)) {
+		cout << path << ": truncated" << endl;
+		return false;
+	}
+	memcpy(&h, file.data, sizeof(h));
+	if (!check_header(h, BINARY_VECTOR_MAGIC, path)) return false;
+	if (file.size < sizeof(h) + h.rows * h.scalar_size) {
+		cout << path << ": truncated" << endl;
+		return false;
+	}
+	b = Matrix <T>(h.rows, 1);
+	convert_scalars(file.data + sizeof(h), h.scalar_size, b.data(), h.rows);
+	return true;
+}
+
+/* matrix or vector file of either format: .mtx is Matrix Market, anything else binary */
+template <class T>
+bool read_matrix(const string& path, Matrix_csr <T>& A) {
+	if (!has_extension(path, ".mtx")) return read_binary(path, A);
+	Matrix_coo <T> coo;
+	if (!read_matrix_market(path, coo)) return false;
+	A = Matrix_csr <T>(coo);
+	return true;
+}
+template <class T>
+bool read_vector(const string& path, Matrix <T>& b) {
+	return has_extension(path, ".mtx") ? read_matrix_market(path, b) : read_binary(path, b);
+}
+template <class T>
+bool write_matrix(const string& path, const Matrix_csr <T>& A) {
+	return has_extension(path, ".mtx") ? write_matrix_market(path, A) : write_binary(path, A);
+}
+template <class T>
+bool write_vector(const string& path, const Matrix <T>& b) {
+	return has_extension(path, ".mtx") ? write_matrix_market(path, b) : write_binary(path, b);
+}
+
+/* MPI datatype matching the scalar type of the solver */
+template <class T>
+MPI_Datatype mpi_type();
+template <>
+MPI_Datatype mpi_type<float>() { return MPI_FLOAT; }
+template <>
+MPI_Datatype mpi_type<double>() { return MPI_DOUBLE; }
+template <>
+MPI_Datatype mpi_type<long double>() { return MPI_LONG_DOUBLE; }
+template <>
+MPI_Datatype mpi_type<int>() { return MPI_INT; }
+
+/*
+	partitioning of the MPI layouts. block_range cuts [0, n) into parts pieces whose
+	lengths differ by at most one. grid_dims factors parts into the px x py process
+	grid that exchanges the fewest halo points, (px - 1) * ny + (py - 1) * nx, when
+	an nx x ny grid is cut into block_range blocks; so any rank count works, and a
+	prime one becomes strips across the longer side. factorizations that would leave
+	a rank without grid points are only taken when there is no other
+*/
+inline void block_range(int n, int parts, int idx, int& begin, int& end) {
+	int len = n / parts, extra = n % parts;
+	begin = idx * len + min(idx, extra);
+	end = begin + len + (idx < extra ? 1 : 0);
+}
+
+inline void grid_dims(int nx, int ny, int parts, int dims[2]) {
+	long long best = -1;
+	bool best_full = false;
+	dims[0] = parts, dims[1] = 1;
+	for (int px = 1; px <= parts; ++px) {
+		if (parts % px) continue;
+		int py = parts / px;
+		bool full = px <= nx && py <= ny;
+		long long halo = (long long)(px - 1) * ny + (long long)(py - 1) * nx;
+		if (best < 0 || (full && !best_full) || (full == best_full && halo < best)) {
+			best = halo, best_full = full;
+			dims[0] = px, dims[1] = py;
+		}
+	}
+}
+
+/*
+	graph partitioning of general sparse matrices, after METIS (Karypis and Kumar):
+	multilevel recursive bisection of the adjacency graph of A + A^T. a bisection
+	coarsens the graph by heavy-edge matching down to GRAPH_COARSEST vertices,
+	bisects the coarsest graph by growing a region from GRAPH_SEEDS seeds and refines
+	the cut with Fiduccia-Mattheyses passes at every level on the way back up; k parts
+	are a bisection into floor(k/2) and ceil(k/2) parts' worth of weight, recursively.
+	the visiting orders come from a fixed-seed generator, so a matrix always gets the
+	same partition
+*/
+const int GRAPH_COARSEST = 80;
+const int GRAPH_SEEDS = 4;
+const int GRAPH_FM_PASSES = 6;
+/* the lighter side of a bisection may miss its target weight by this fraction of it; the slack compounds over the levels of the recursion */
+const double GRAPH_IMBALANCE = 0.01;
+const unsigned GRAPH_SEED = 1;
+
+/* undirected graph in CSR form with vertex and edge weights */
+struct Graph {
+	int n = 0;
+	vector < int > xadj, adj, vwgt, ewgt;
+
+	long long total_weight() const {
+		return std::accumulate(vwgt.begin(), vwgt.end(), 0LL);
+	}
+};
+
+/* pattern of A + A^T without the diagonal, unit weights */
+template <class T>
+Graph matrix_graph(const Matrix_csr <T>& A) {
+	Graph g;
+	g.n = A.n;
+	g.xadj.assign(g.n + 1, 0);
+	for (int r = 0; r < A.n; ++r) {
+		for (int k = A.row_ptr[r]; k < A.row_ptr[r + 1]; ++k) {
+			if (A.col[k] != r) g.xadj[r + 1]++, g.xadj[A.col[k] + 1]++;
+		}
+	}
+	for (int v = 0; v < g.n; ++v) g.xadj[v + 1] += g.xadj[v];
+	vector < int > fill(g.xadj.begin(), g.xadj.end() - 1);
+	g.adj.resize(g.xadj[g.n]);
+	for (int r = 0; r < A.n; ++r) {
+		for (int k = A.row_ptr[r]; k < A.row_ptr[r + 1]; ++k) {
+			int c = A.col[k];
+			if (c != r) g.adj[fill[r]++] = c, g.adj[fill[c]++] = r;
+		}
+	}
+	/* both triangles of a symmetric matrix list every edge twice */
+	int out = 0;
+	for (int v = 0; v < g.n; ++v) {
+		int begin = g.xadj[v], end = g.xadj[v + 1];
+		std::sort(g.adj.begin() + begin, g.adj.begin() + end);
+		g.xadj[v] = out;
+		for (int k = begin; k < end; ++k) {
+			if (k == begin || g.adj[k] != g.adj[k - 1]) g.adj[out++] = g.adj[k];
+		}
+	}
+	g.xadj[g.n] = out;
+	g.adj.resize(out);
+	g.vwgt.assign(g.n, 1);
+	g.ewgt.assign(out, 1);
+	return g;
+}
+
+/* heavy-edge matching: every vertex is merged with its heaviest unmatched neighbour, map[v] = coarse vertex */
+Graph coarsen(const Graph& g, vector < int >& map, std::mt19937& gen) {
+	vector < int > order(g.n);
+	std::iota(order.begin(), order.end(), 0);
+	std::shuffle(order.begin(), order.end(), gen);
+	map.assign(g.n, -1);
+	int cn = 0;
+	for (int v : order) {
+		if (map[v] >= 0) continue;
+		int mate = -1, heaviest = 0;
+		for (int k = g.xadj[v]; k < g.xadj[v + 1]; ++k) {
+			if (map[g.adj[k]] < 0 && g.ewgt[k] > heaviest) mate = g.adj[k], heaviest = g.ewgt[k];
+		}
+		map[v] = cn;
+		if (mate >= 0) map[mate] = cn;
+		cn++;
+	}
+	/* fine vertices grouped by coarse vertex */
+	vector < int > first(cn + 1, 0), members(g.n);
+	for (int v = 0; v < g.n; ++v) first[map[v] + 1]++;
+	for (int c = 0; c < cn; ++c) first[c + 1] += first[c];
+	vector < int > at(first.begin(), first.end() - 1);
+	for (int v = 0; v < g.n; ++v) members[at[map[v]]++] = v;
+
+	Graph c;
+	c.n = cn;
+	c.xadj.assign(cn + 1, 0);
+	c.vwgt.assign(cn, 0);
+	vector < int > slot(cn, -1);
+	for (int cv = 0; cv < cn; ++cv) {
+		int row = c.adj.size();
+		for (int i = first[cv]; i < first[cv + 1]; ++i) {
+			int v = members[i];
+			c.vwgt[cv] += g.vwgt[v];
+			for (int k = g.xadj[v]; k < g.xadj[v + 1]; ++k) {
+				int cu = map[g.adj[k]];
+				if (cu == cv) continue;
+				if (slot[cu] < row) {
+					slot[cu] = c.adj.size();
+					c.adj.push_back(cu);
+					c.ewgt.push_back(g.ewgt[k]);
+				}
+				else {
+					c.ewgt[slot[cu]] += g.ewgt[k];
+				}
+			}
+		}
+		c.xadj[cv + 1] = c.adj.size();
+	}
+	return c;
+}
+
+long long cut_weight(const Graph& g, const vector < char >& side) {
+	long long cut = 0;
+	for (int v = 0; v < g.n; ++v) {
+		for (int k = g.xadj[v]; k < g.xadj[v + 1]; ++k) {
+			if (side[v] != side[g.adj[k]]) cut += g.ewgt[k];
+		}
+	}
+	return cut / 2;
+}
+
+/*
+	Fiduccia-Mattheyses refinement of a bisection whose side 0 should weigh target:
+	every pass moves vertices one at a time, always the best-gain move that keeps
+	(or brings) the lighter side within GRAPH_IMBALANCE of its target, each vertex at
+	most once, and then rolls back to the best cut seen. stops when a pass finds
+	nothing better
+*/
+void fm_refine(const Graph& g, vector < char >& side, long long target) {
+	long long total = g.total_weight();
+	long long slack = max((long long)(GRAPH_IMBALANCE * min(target, total - target)), (long long)*std::max_element(g.vwgt.begin(), g.vwgt.end()));
+	vector < long long > gain(g.n);
+	vector < char > moved(g.n);
+	for (int pass = 0; pass < GRAPH_FM_PASSES; ++pass) {
+		long long w0 = 0, cut = 0;
+		for (int v = 0; v < g.n; ++v) {
+			if (side[v] == 0) w0 += g.vwgt[v];
+			gain[v] = 0;
+			for (int k = g.xadj[v]; k < g.xadj[v + 1]; ++k) {
+				gain[v] += side[v] != side[g.adj[k]] ? g.ewgt[k] : -g.ewgt[k];
+			}
+			if (side[v] == 0) {
+				for (int k = g.xadj[v]; k < g.xadj[v + 1]; ++k) cut += side[g.adj[k]] ? g.ewgt[k] : 0;
+			}
+		}
+		/* max-heaps of (gain, vertex) per side; entries whose gain changed since are skipped */
+		std::priority_queue < pair < long long, int > > heap[2];
+		for (int v = 0; v < g.n; ++v) {
+			bool boundary = false;
+			for (int k = g.xadj[v]; k < g.xadj[v + 1] && !boundary; ++k) boundary = side[v] != side[g.adj[k]];
+			if (boundary) heap[(int)side[v]].push({ gain[v], v });
+		}
+		std::fill(moved.begin(), moved.end(), 0);
+		vector < int > moves;
+		auto imbalance = [&](long long w) { return w > target ? w - target : target - w; };
+		long long best_cut = cut, best_imb = imbalance(w0);
+		bool best_ok = best_imb <= slack;
+		size_t best_len = 0;
+		size_t patience = max(50, g.n / 50);
+		while (moves.size() < best_len + patience) {
+			int pick = -1;
+			for (int from = 0; from < 2; ++from) {
+				auto& h = heap[from];
+				while (!h.empty() && (moved[h.top().second] || side[h.top().second] != from || gain[h.top().second] != h.top().first)) h.pop();
+				if (h.empty()) continue;
+				int v = h.top().second;
+				long long w = w0 + (from == 0 ? -g.vwgt[v] : g.vwgt[v]);
+				if (imbalance(w) > slack && imbalance(w) >= imbalance(w0)) continue;
+				if (pick < 0 || gain[v] > gain[pick]) pick = v;
+			}
+			if (pick < 0) break;
+			int v = pick, from = side[v];
+			heap[from].pop();
+			side[v] = 1 - from;
+			w0 += from == 0 ? -g.vwgt[v] : g.vwgt[v];
+			cut -= gain[v];
+			gain[v] = -gain[v];
+			moved[v] = 1;
+			moves.push_back(v);
+			for (int k = g.xadj[v]; k < g.xadj[v + 1]; ++k) {
+				int u = g.adj[k];
+				gain[u] += side[u] == side[v] ? -2 * g.ewgt[k] : 2 * g.ewgt[k];
+				if (!moved[u]) heap[(int)side[u]].push({ gain[u], u });
+			}
+			long long imb = imbalance(w0);
+			bool ok = imb <= slack;
+			if ((ok && (!best_ok || cut < best_cut || (cut == best_cut && imb < best_imb))) || (!ok && !best_ok && imb < best_imb)) {
+				best_cut = cut, best_imb = imb, best_ok = ok;
+				best_len = moves.size();
+			}
+		}
+		for (size_t i = moves.size(); i > best_len; --i) side[moves[i - 1]] ^= 1;
+		if (best_len == 0) break;
+	}
+}
+
+/* region growing from random seeds (a new one whenever the region runs out of neighbours), best refined cut */
+vector < char > grow_bisection(const Graph& g, long long target, std::mt19937& gen) {
+	vector < char > best;
+	long long best_cut = -1;
+	for (int attempt = 0; attempt < GRAPH_SEEDS; ++attempt) {
+		vector < char > side(g.n, 1), queued(g.n, 0);
+		std::deque < int > frontier;
+		long long w0 = 0;
+		int next = g.n ? (int)(gen() % g.n) : 0;
+		for (int scanned = 0; w0 < target && scanned <= g.n;) {
+			if (frontier.empty()) {
+				while (scanned < g.n && queued[(next + scanned) % g.n]) ++scanned;
+				if (scanned == g.n) break;
+				int v = (next + scanned) % g.n;
+				queued[v] = 1;
+				frontier.push_back(v);
+			}
+			int v = frontier.front();
+			frontier.pop_front();
+			side[v] = 0;
+			w0 += g.vwgt[v];
+			for (int k = g.xadj[v]; k < g.xadj[v + 1]; ++k) {
+				if (!queued[g.adj[k]]) queued[g.adj[k]] = 1, frontier.push_back(g.adj[k]);
+			}
+		}
+		fm_refine(g, side, target);
+		long long cut = cut_weight(g, side);
+		if (best_cut < 0 || cut < best_cut) best_cut = cut, best = side;
+	}
+	return best;
+}
+
+/* multilevel bisection, side 0 weighing about target */
+vector < char > bisect(const Graph& g, long long target, std::mt19937& gen) {
+	if (g.n <= GRAPH_COARSEST) return grow_bisection(g, target, gen);
+	vector < int > map;
+	Graph c = coarsen(g, map, gen);
+	/* matching no longer shrinks the graph (few edges left): bisect it as it is */
+	if (c.n > 0.95 * g.n) return grow_bisection(g, target, gen);
+	vector < char > coarse = bisect(c, target, gen), side(g.n);
+	for (int v = 0; v < g.n; ++v) side[v] = coarse[map[v]];
+	fm_refine(g, side, target);
+	return side;
+}
+
+/* subgraph on the vertices of the given side, ids maps its vertices back to g's */
+Graph induced_subgraph(const Graph& g, const vector < char >& side, char which, vector < int >& ids) {
+	vector < int > local(g.n, -1);
+	ids.clear();
+	for (int v = 0; v < g.n; ++v) {
+		if (side[v] == which) local[v] = ids.size(), ids.push_back(v);
+	}
+	Graph s;
+	s.n = ids.size();
+	s.xadj.assign(s.n + 1, 0);
+	for (int i = 0; i < s.n; ++i) {
+		int v = ids[i];
+		s.vwgt.push_back(g.vwgt[v]);
+		for (int k = g.xadj[v]; k < g.xadj[v + 1]; ++k) {
+			if (local[g.adj[k]] >= 0) s.adj.push_back(local[g.adj[k]]), s.ewgt.push_back(g.ewgt[k]);
+		}
+		s.xadj[i + 1] = s.adj.size();
+	}
+	return s;
+}
+
+/* parts parts numbered from first for the vertices of g, written to part[ids[v]] */
+void partition_recursive(const Graph& g, const vector < int >& ids, int parts, int first, vector < int >& part, std::mt19937& gen) {
+	if (parts == 1 || g.n == 0) {
+		for (int v = 0; v < g.n; ++v) part[ids[v]] = first;
+		return;
+	}
+	int left = parts / 2;
+	vector < char > side = bisect(g, g.total_weight() * left / parts, gen);
+	for (char which = 0; which < 2; ++which) {
+		vector < int > sub_ids;
+		Graph sub = induced_subgraph(g, side, which, sub_ids);
+		for (auto& v : sub_ids) v = ids[v];
+		partition_recursive(sub, sub_ids, which ? parts - left : left, which ? first + left : first, part, gen);
+	}
+}
+
+/* part of every row of the square matrix A, in [0, parts) */
+template <class T>
+vector < int > graph_partition(const Matrix_csr <T>& A, int parts) {
+	Graph g = matrix_graph(A);
+	vector < int > ids(g.n), part(g.n, 0);
+	std::iota(ids.begin(), ids.end(), 0);
+	std::mt19937 gen(GRAPH_SEED);
+	partition_recursive(g, ids, max(1, parts), 0, part, gen);
+	return part;
+}
+
+template <class T>
+vector < int > graph_partition(const Matrix_coo <T>& A, int parts) {
+	return graph_partition(Matrix_csr <T>(A), parts);
+}
+
+/* rows grouped part by part: order[new] = old, part p is [starts[p], starts[p + 1]) */
+void partition_order(const vector < int >& part, int parts, vector < int >& order, vector < int >& starts) {
+	starts.assign(parts + 1, 0);
+	for (int p : part) starts[p + 1]++;
+	for (int p = 0; p < parts; ++p) starts[p + 1] += starts[p];
+	vector < int > at(starts.begin(), starts.end() - 1);
+	order.resize(part.size());
+	for (size_t v = 0; v < part.size(); ++v) order[at[part[v]]++] = v;
+}
+
+/* P A P^T for the permutation order[new] = old: B(i, j) = A(order[i], order[j]), columns sorted */
+template <class T>
+Matrix_csr <T> permute_symmetric(const Matrix_csr <T>& A, const vector < int >& order) {
+	vector < int > inverse(A.n);
+	for (int i = 0; i < A.n; ++i) inverse[order[i]] = i;
+	Matrix_csr <T> B;
+	B.n = A.n, B.m = A.m;
+	B.row_ptr.assign(A.n + 1, 0);
+	B.col.reserve(A.nnz());
+	B.val.reserve(A.nnz());
+	vector < pair < int, T > > row;
+	for (int i = 0; i < A.n; ++i) {
+		int r = order[i];
+		row.clear();
+		for (int k = A.row_ptr[r]; k < A.row_ptr[r + 1]; ++k) row.push_back({ inverse[A.col[k]], A.val[k] });
+		std::sort(row.begin(), row.end(), [](const pair < int, T >& a, const pair < int, T >& b) { return a.first < b.first; });
+		for (auto& e : row) B.col.push_back(e.first), B.val.push_back(e.second);
+		B.row_ptr[i + 1] = B.col.size();
+	}
+	return B;
+}
+
+/*
+	task engine of the master/worker path. the master drives the workers with typed
+	commands: every command starts with a broadcast {opcode, vector length} header
+	and each worker looks the opcode up in its dispatch table (run_worker), so new
+	operations are one enum entry plus one handler. OP_SHUTDOWN ends the worker loop;
+	nothing depends on how many commands the master issues per iteration.
+	every command ships a worker's whole slice in one collective
+	(Scatterv/Gatherv/Bcast/Reduce) instead of one message per element
+*/
+enum WorkerOp { OP_SHUTDOWN, OP_MATVEC, OP_BATCH, OP_COUNT };
+
+/*
+	per-rank slices of an n-vector: the master (rank 0) holds nothing,
+	worker i gets [displs[i], displs[i] + counts[i]), the slices of the
+	size - 1 workers differing in length by at most one
+*/
+struct SliceLayout {
+	vector < int > counts, displs;
+};
+
+SliceLayout worker_slices(int n, int size) {
+	SliceLayout L;
+	L.counts.assign(size, 0);
+	L.displs.assign(size, 0);
+	for (int i = 1; i < size; ++i) {
+		int begin, end;
+		block_range(n, size - 1, i - 1, begin, end);
+		L.displs[i] = begin;
+		L.counts[i] = end - begin;
+	}
+	return L;
+}
+
+/* announces the next command to every worker: {opcode, vector length} */
+void broadcast_header(int& op, int& n) {
+	int header[2] = { op, n };
+	MPI_Bcast(header, 2, MPI_INT, MASTER, MPI_COMM_WORLD);
+	op = header[0], n = header[1];
+}
+
+/* master side: full vector -> one slice per worker */
+template <class T>
+void scatter_slices(Matrix <T>& full, const SliceLayout& L) {
+	MPI_Scatterv(full.data(), L.counts.data(), L.displs.data(), mpi_type<T>(),
+		MPI_IN_PLACE, 0, mpi_type<T>(), MASTER, MPI_COMM_WORLD);
+}
+/* worker side: receives its slice into local */
+template <class T>
+void scatter_slices(Matrix <T>& local) {
+	MPI_Scatterv(NULL, NULL, NULL, mpi_type<T>(),
+		local.data(), (int)local.size(), mpi_type<T>(), MASTER, MPI_COMM_WORLD);
+}
+/* master side: one slice per worker -> full vector */
+template <class T>
+void gather_slices(Matrix <T>& full, const SliceLayout& L) {
+	MPI_Gatherv(MPI_IN_PLACE, 0, mpi_type<T>(),
+		full.data(), L.counts.data(), L.displs.data(), mpi_type<T>(), MASTER, MPI_COMM_WORLD);
+}
+/* worker side: sends its slice back */
+template <class T>
+void gather_slices(Matrix <T>& local) {
+	MPI_Gatherv(local.data(), (int)local.size(), mpi_type<T>(),
+		NULL, NULL, NULL, mpi_type<T>(), MASTER, MPI_COMM_WORLD);
+}
+/*
+	a batch of elementwise vector ops, shipped to the workers as one OP_BATCH command:
+	the vectors flagged BATCH_IN are scattered once, the ops run back to back on every
+	worker's slices in submission order (so an op may use what an earlier one wrote),
+	the vectors flagged BATCH_OUT are gathered once and all queued dot products come
+	back in a single reduction. independent updates, such as the X and R steps of CG,
+	thus share one round trip instead of costing one each
+*/
+enum BatchSlotFlags { BATCH_IN = 1, BATCH_OUT = 2 };
+enum BatchOpKind { BATCH_AXPY, BATCH_DOT };
+/* ints per op on the wire: {kind, out, a, b, coefficient index} */
+const int BATCH_OP_WIDTH = 5;
+
+template <class T>
+class WorkerBatch {
+public:
+	vector < Matrix <T>* > vectors;
+	vector < int > flags, ops;
+	vector < T > coefs;
+	int dots = 0;
+
+	/* registers v with the batch, returns its slot */
+	int add(Matrix <T>& v, int f) {
+		vectors.push_back(&v);
+		flags.push_back(f);
+		return vectors.size() - 1;
+	}
+
+	/* slot out = slot a + c * slot b */
+	void axpy(int out, int a, T c, int b) {
+		int op[BATCH_OP_WIDTH] = { BATCH_AXPY, out, a, b, (int)coefs.size() };
+		ops.insert(ops.end(), op, op + BATCH_OP_WIDTH);
+		coefs.push_back(c);
+	}
+
+	/* queues slot a . slot b, returns its index among the results of run */
+	int dot(int a, int b) {
+		int op[BATCH_OP_WIDTH] = { BATCH_DOT, dots, a, b, -1 };
+		ops.insert(ops.end(), op, op + BATCH_OP_WIDTH);
+		return dots++;
+	}
+
+	/*
+		master side: runs the batch on the workers, returns the dot products.
+		the whole round trip counts as axpy, the closing reduction as reduce
+	*/
+	vector < T > run(int size) {
+		PhaseTimer timer(PHASE_AXPY);
+		int op = OP_BATCH, n = vectors[0]->getRowSize();
+		SliceLayout L = worker_slices(n, size);
+		int shape[4] = { (int)vectors.size(), (int)ops.size() / BATCH_OP_WIDTH, (int)coefs.size(), dots };
+		broadcast_header(op, n);
+		MPI_Bcast(shape, 4, MPI_INT, MASTER, MPI_COMM_WORLD);
+		MPI_Bcast(flags.data(), shape[0], MPI_INT, MASTER, MPI_COMM_WORLD);
+		MPI_Bcast(ops.data(), (int)ops.size(), MPI_INT, MASTER, MPI_COMM_WORLD);
+		MPI_Bcast(coefs.data(), shape[2], mpi_type<T>(), MASTER, MPI_COMM_WORLD);
+		count_sent((long long)(2 + 4 + shape[0] + ops.size()) * sizeof(int) + (long long)shape[2] * sizeof(T), 5LL * (size - 1));
+		for (size_t v = 0; v < vectors.size(); ++v) {
+			if (flags[v] & BATCH_IN) scatter_slices(*vectors[v], L), count_sent((long long)n * sizeof(T), size - 1);
+		}
+		for (size_t v = 0; v < vectors.size(); ++v) {
+			if (flags[v] & BATCH_OUT) gather_slices(*vectors[v], L);
+		}
+		vector < T > zero(dots, T(0)), result(dots);
+		if (dots) {
+			PhaseTimer reduce(PHASE_REDUCE);
+			MPI_Reduce(zero.data(), result.data(), dots, mpi_type<T>(), MPI_SUM, MASTER, MPI_COMM_WORLD);
+			count_sent(dots * sizeof(T));
+		}
+		return result;
+	}
+};
+
+/*
+	worker side of OP_BATCH. an axpy writing one of its own inputs runs in place
+	(axpy or xpay), and an in-place axpy immediately followed by the dot of its
+	output with itself is fused into one axpy_dot pass
+*/
+template <class T>
+void vector_batch(int rank, int size, int n) {
+	PhaseTimer timer(PHASE_AXPY);
+	SliceLayout L = worker_slices(n, size);
+	int shape[4];
+	MPI_Bcast(shape, 4, MPI_INT, MASTER, MPI_COMM_WORLD);
+	vector < int > flags(shape[0]), ops(shape[1] * BATCH_OP_WIDTH);
+	vector < T > coefs(shape[2]), dots(shape[3], T(0)), result(shape[3]);
+	MPI_Bcast(flags.data(), shape[0], MPI_INT, MASTER, MPI_COMM_WORLD);
+	MPI_Bcast(ops.data(), (int)ops.size(), MPI_INT, MASTER, MPI_COMM_WORLD);
+	MPI_Bcast(coefs.data(), shape[2], mpi_type<T>(), MASTER, MPI_COMM_WORLD);
+	vector < Matrix <T> > v(shape[0], Matrix <T>(L.counts[rank], 1));
+	for (int i = 0; i < shape[0]; ++i) {
+		if (flags[i] & BATCH_IN) scatter_slices(v[i]);
+	}
+	for (int i = 0; i < shape[1]; ++i) {
+		const int* op = &ops[i * BATCH_OP_WIDTH];
+		const int* next = i + 1 < shape[1] ? op + BATCH_OP_WIDTH : nullptr;
+		if (op[0] == BATCH_DOT) {
+			dots[op[1]] = dot(v[op[2]], v[op[3]]);
+		}
+		else if (op[1] == op[2] && next && next[0] == BATCH_DOT && next[2] == op[1] && next[3] == op[1]) {
+			dots[next[1]] = axpy_dot(v[op[1]], coefs[op[4]], v[op[3]]);
+			++i;
+		}
+		else if (op[1] == op[3] && op[1] != op[2]) {
+			/* out = a + c * out */
+			xpay(v[op[1]], coefs[op[4]], v[op[2]]);
+		}
+		else {
+			if (op[1] != op[2]) v[op[1]] = v[op[2]];
+			axpy(v[op[1]], coefs[op[4]], v[op[3]]);
+		}
+	}
+	for (int i = 0; i < shape[0]; ++i) {
+		if (flags[i] & BATCH_OUT) gather_slices(v[i]), count_sent((long long)L.counts[rank] * sizeof(T));
+	}
+	if (shape[3]) {
+		PhaseTimer reduce(PHASE_REDUCE);
+		MPI_Reduce(dots.data(), result.data(), shape[3], mpi_type<T>(), MPI_SUM, MASTER, MPI_COMM_WORLD);
+		count_sent(shape[3] * sizeof(T));
+	}
+}
+
+/*
+	the world - 1 workers form the grid_dims process grid over the nx x ny grid, and
+	worker i gets its block [Lr, Rr] x [Lc, Rc] together with the values of b on the
+	block plus a one-cell ring (0 outside the grid) and the stencil coefficients, and
+	returns only the product on its own block; a worker whose block would be empty
+	(more workers than grid rows or columns) gets bounds with R < L. traffic per worker
+	is O(block) instead of O(n)
+*/
+template <class T>
+void matrix_vector_mult_MASTER(Matrix <T>& res, PoissonStencil<T>& A, Matrix<T>& b, int n) {
+	PhaseTimer timer(PHASE_SPMV);
+	int op = OP_MATVEC, world, dims[2];
+	MPI_Comm_size(MPI_COMM_WORLD, &world);
+	grid_dims(A.nx, A.ny, world - 1, dims);
+
+	vector < int > bounds(4 * world, 0), counts(world, 0), displs(world, 0), res_counts(world, 0), res_displs(world, 0);
+	vector < int > owned;
+	vector < T > values;
+	for (int i = 1; i < world; ++i) {
+		int Lr, Lc, Rr, Rc;
+		block_range(A.nx, dims[0], (i - 1) / dims[1], Lr, Rr);
+		block_range(A.ny, dims[1], (i - 1) % dims[1], Lc, Rc);
+		--Rr, --Rc;
+		bounds[4 * i] = Lr, bounds[4 * i + 1] = Lc;
+		bounds[4 * i + 2] = Rr, bounds[4 * i + 3] = Rc;
+		displs[i] = values.size();
+		res_displs[i] = owned.size();
+		for (int j = Lr - 1; j <= Rr + 1 && Rr >= Lr && Rc >= Lc; ++j) {
+			for (int k = Lc - 1; k <= Rc + 1; ++k) {
+				int idx = map_to_int(j, k, A.nx, A.ny);
+				values.push_back(idx != -1 ? b[idx] : 0.0);
+				if (j >= Lr && j <= Rr && k >= Lc && k <= Rc) owned.push_back(idx);
+			}
+		}
+		counts[i] = values.size() - displs[i];
+		res_counts[i] = owned.size() - res_displs[i];
+	}
+
+	T coeffs[2] = { A.center, A.off };
+	broadcast_header(op, n);
+	MPI_Scatter(bounds.data(), 4, MPI_INT, MPI_IN_PLACE, 4, MPI_INT, MASTER, MPI_COMM_WORLD);
+	MPI_Bcast(coeffs, 2, mpi_type<T>(), MASTER, MPI_COMM_WORLD);
+	MPI_Scatterv(values.data(), counts.data(), displs.data(), mpi_type<T>(), MPI_IN_PLACE, 0, mpi_type<T>(), MASTER, MPI_COMM_WORLD);
+	/* header, bounds, coefficients and b to every worker */
+	count_sent((long long)(2 + 4 * (world - 1)) * sizeof(int) + (long long)(2 + values.size()) * sizeof(T), 4LL * (world - 1));
+
+	vector < T > gathered(owned.size());
+	MPI_Gatherv(MPI_IN_PLACE, 0, mpi_type<T>(),
+		gathered.data(), res_counts.data(), res_displs.data(), mpi_type<T>(), MASTER, MPI_COMM_WORLD);
+	for (int j = 0; j < n; ++j) {
+		res[j] = 0.0;
+	}
+	for (size_t j = 0; j < owned.size(); ++j) {
+		res[owned[j]] = gathered[j];
+	}
+	return;
+}
+template <class T>
+void matrix_vector_mult(int /*rank*/, int /*size*/, int /*n*/) {
+	PhaseTimer timer(PHASE_SPMV);
+	int bounds[4];
+	T coeffs[2];
+	MPI_Scatter(NULL, 4, MPI_INT, bounds, 4, MPI_INT, MASTER, MPI_COMM_WORLD);
+	MPI_Bcast(coeffs, 2, mpi_type<T>(), MASTER, MPI_COMM_WORLD);
+	int Lr = bounds[0], Lc = bounds[1], Rr = bounds[2], Rc = bounds[3];
+	int rows = max(0, Rr - Lr + 1), cols = max(0, Rc - Lc + 1);
+	bool active = rows > 0 && cols > 0;
+
+	/* block plus ring of b, the ring cells outside the grid arrive as 0 */
+	Matrix < T > b(active ? rows + 2 : 0, active ? cols + 2 : 0);
+	MPI_Scatterv(NULL, NULL, NULL, mpi_type<T>(), b.data(), (int)b.size(), mpi_type<T>(), MASTER, MPI_COMM_WORLD);
+
+	Matrix < T > res(active ? rows * cols : 0, 1);
+	if (active) {
+		PoissonStencil < T > S(rows, cols, coeffs[0], coeffs[1]);
+		S.apply_ghosted(b.data(), rows, cols, res.data());
+	}
+	MPI_Gatherv(res.data(), (int)res.size(), mpi_type<T>(), NULL, NULL, NULL, mpi_type<T>(), MASTER, MPI_COMM_WORLD);
+	count_sent(res.size() * sizeof(T));
+	return;
+}
+
+/*
+	distributed-memory layout for the nx x ny Poisson grid
+	the ranks form a 2D Cartesian grid (MPI_Cart_create) and rank (cx, cy) owns the
+	block [row_begin, row_end) x [col_begin, col_end) of grid points. Every rank keeps
+	its slice of every CG vector (x, r, p, Ap) resident across iterations; per step
+	only the block edges go to the four neighbours and the scalar reductions are global
+*/
+template <class T>
+class DistributedPoisson {
+public:
+	MPI_Comm comm;
+	int rank, size, nx, ny, dims[2], coords[2];
+	/* the operator restricted to this rank's block */
+	PoissonStencil < T > stencil;
+	int row_begin, row_end, col_begin, col_end;
+	/* neighbours in the Cartesian grid, MPI_PROC_NULL on the physical boundary */
+	int up, down, left, right;
+
+	DistributedPoisson(const PoissonStencil < T >& A, MPI_Comm c) {
+		nx = A.nx, ny = A.ny;
+		MPI_Comm_size(c, &size);
+		grid_dims(nx, ny, size, dims);
+		int periods[2] = { 0, 0 };
+		MPI_Cart_create(c, 2, dims, periods, 1, &comm);
+		MPI_Comm_rank(comm, &rank);
+		MPI_Cart_coords(comm, rank, 2, coords);
+		block_range(nx, dims[0], coords[0], row_begin, row_end);
+		block_range(ny, dims[1], coords[1], col_begin, col_end);
+		setup(A);
+	}
+
+	/*
+		the block [rb, re) x [cb, ce) of the grid of A on (a duplicate of) an existing
+		Cartesian communicator, such as the coarse levels of DistributedMultigrid whose
+		blocks follow the fine ones. the blocks of all ranks must tile the grid
+	*/
+	DistributedPoisson(const PoissonStencil < T >& A, MPI_Comm cart, int rb, int re, int cb, int ce) {
+		nx = A.nx, ny = A.ny;
+		MPI_Comm_dup(cart, &comm);
+		MPI_Comm_size(comm, &size);
+		MPI_Comm_rank(comm, &rank);
+		int periods[2];
+		MPI_Cart_get(comm, 2, dims, periods, coords);
+		row_begin = rb, row_end = re, col_begin = cb, col_end = ce;
+		setup(A);
+	}
+
+	~DistributedPoisson() {
+		free_deep_types();
+		MPI_Type_free(&column_type);
+		MPI_Type_free(&ring_row_type);
+		MPI_Type_free(&ring_column_type);
+		MPI_Comm_free(&comm);
+	}
+
+	int local_rows() const { return row_end - row_begin; }
+	int local_cols() const { return col_end - col_begin; }
+	int local_size() const { return local_rows() * local_cols(); }
+
+	/*
+		y = A * x on the local blocks; x is copied into a buffer with a one-cell ghost
+		ring, the ring is filled with the neighbours' edge rows/columns and stays 0 on
+		the physical boundary. the exchange is non-blocking: the points away from the
+		block's edge are computed while it is in flight, the edge ones once it lands
+	*/
+	void apply(const Matrix <T>& x, Matrix <T>& y) {
+		PhaseTimer timer(PHASE_SPMV);
+		int rows = local_rows(), cols = local_cols(), w = cols + 2;
+		copy_to_ghost(x);
+		start_halo();
+		/* points whose four neighbours are all local, while the halo is in flight */
+		const T* g = ghost.data();
+		T c = stencil.center, o = stencil.off;
+		if (cols > 2) {
+			OMP(omp parallel for if(run_parallel(local_size())) schedule(static))
+			for (int i = 2; i < rows; ++i) {
+				stencil_row_kernel(g + (i - 1) * w + 2, g + i * w + 2, g + (i + 1) * w + 2, c, o, y.data() + (i - 1) * cols + 1, cols - 2);
+			}
+		}
+		finish_halo();
+		/* the boundary ring: first and last row, then first and last column between them */
+		if (rows == 0 || cols == 0) return;
+		for (int i : { 1, rows }) {
+			stencil_row_kernel(g + (i - 1) * w + 1, g + i * w + 1, g + (i + 1) * w + 1, c, o, y.data() + (i - 1) * cols, cols);
+			if (rows == 1) break;
+		}
+		for (int i = 2; i < rows; ++i) {
+			for (int j : { 1, cols }) {
+				stencil_row_kernel(g + (i - 1) * w + j, g + i * w + j, g + (i + 1) * w + j, c, o, y.data() + (i - 1) * cols + j - 1, 1);
+				if (cols == 1) break;
+			}
+		}
+	}
+
+	/*
+		x with its one-cell ghost ring, (local_rows() + 2) x (local_cols() + 2) row-major;
+		valid until the next apply or fill_ghost
+	*/
+	const T* fill_ghost(const Matrix <T>& x) {
+		copy_to_ghost(x);
+		start_halo();
+		finish_halo();
+		return ghost.data();
+	}
+
+	/*
+		as fill_ghost, with the four corner cells of the ring filled as well (the
+		depth-1 exchange of the matrix powers kernel), for stencils that reach
+		diagonally such as full weighting. same buffer and layout
+	*/
+	const T* fill_ghost_corners(const Matrix <T>& x) {
+		PhaseTimer timer(PHASE_SPMV);
+		if (local_size() == 0) return ghost.data();
+		copy_to_ghost(x);
+		exchange_deep(ghost.data(), 1, local_cols() + 2, ring_row_type, ring_column_type);
+		return ghost.data();
+	}
+
+	/* global sum of one partial value per rank, valid on every rank */
+	T sum(T local) {
+		PhaseTimer timer(PHASE_REDUCE);
+		count_sent(sizeof(T));
+		T global = 0;
+		MPI_Allreduce(&local, &global, 1, mpi_type<T>(), MPI_SUM, comm);
+		return global;
+	}
+
+	/* in-place global sum of count partial values, one reduction for all of them */
+	void sum(T* values, int count) {
+		PhaseTimer timer(PHASE_REDUCE);
+		count_sent(count * sizeof(T));
+		MPI_Allreduce(MPI_IN_PLACE, values, count, mpi_type<T>(), MPI_SUM, comm);
+	}
+
+	/* global dot product of two distributed vectors */
+	T dot(const Matrix <T>& a, const Matrix <T>& b) {
+		return sum(::dot(a, b));
+	}
+
+	/*
+		non-blocking global sum of count partial values, global is only valid
+		after MPI_Wait on the returned request and local must stay untouched until then
+	*/
+	MPI_Request sum_async(const T* local, T* global, int count) {
+		PhaseTimer timer(PHASE_REDUCE);
+		count_sent(count * sizeof(T));
+		MPI_Request req;
+		MPI_Iallreduce(local, global, count, mpi_type<T>(), MPI_SUM, comm, &req);
+		return req;
+	}
+
+	/* deepest halo every neighbour can fill: the shortest side of any non-empty block */
+	int halo_limit() {
+		int mine = local_size() > 0 ? min(local_rows(), local_cols()) : INT_MAX, ret;
+		MPI_Allreduce(&mine, &ret, 1, MPI_INT, MPI_MIN, comm);
+		return ret;
+	}
+
+	/*
+		matrix powers kernel: V[j] = (A / sigma)^j x for j = 0 .. k from a single
+		halo exchange of depth k instead of k exchanges of depth 1. the deep ghost
+		zone is filled rows first and then with full-height columns, so the corner
+		blocks that A^k reaches arrive too. level j is computed on the extended block
+		shrunk by j cells on every side; points outside the grid are never written
+		and stay 0. the pass runs inside the deep buffers of the largest k so far
+		(see prepare_deep), so alternating depths neither reallocate nor create
+		datatypes; k = 0 only copies x. needs k <= halo_limit()
+	*/
+	void powers(const Matrix <T>& x, int k, T sigma, vector < Matrix <T> >& V) {
+		PhaseTimer timer(PHASE_SPMV);
+		V.resize(k + 1);
+		for (int j = 0; j <= k; ++j) {
+			if (V[j].getRowSize() != (size_t)local_size() || V[j].getColSize() != 1) V[j] = Matrix < T >(local_size(), 1);
+		}
+		V[0] = x;
+		if (local_size() == 0 || k == 0) return;
+		prepare_deep(k);
+		/* the depth-k block sits d cells inside the buffer of depth deep_k */
+		int rows = local_rows(), cols = local_cols(), W = cols + 2 * deep_k, d = deep_k - k;
+		int H = rows + 2 * k, w = cols + 2 * k;
+		T* g = deep[0].data() + d * W + d;
+		for (int i = 0; i < rows; ++i) {
+			std::copy(x.data() + i * cols, x.data() + (i + 1) * cols, g + (i + k) * W + k);
+		}
+		exchange_deep(g, k, W, deep_row_types[k - 1], deep_column_types[k - 1]);
+		T c = stencil.center / sigma, o = stencil.off / sigma;
+		for (int j = 1; j <= k; ++j) {
+			const T* src = deep[(j - 1) % 2].data() + d * W + d;
+			T* dst = deep[j % 2].data() + d * W + d;
+			int r0 = max(j, k - row_begin), r1 = min(H - j, k + nx - row_begin);
+			int c0 = max(j, k - col_begin), c1 = min(w - j, k + ny - col_begin);
+			OMP(omp parallel for if(run_parallel((size_t)(r1 - r0) * (c1 - c0))) schedule(static))
+			for (int i = r0; i < r1; ++i) {
+				stencil_row_kernel(src + (i - 1) * W + c0, src + i * W + c0, src + (i + 1) * W + c0, c, o, dst + i * W + c0, c1 - c0);
+			}
+			for (int i = 0; i < rows; ++i) {
+				std::copy(dst + (i + k) * W + k, dst + (i + k) * W + k + cols, V[j].data() + i * cols);
+			}
+		}
+	}
+
+private:
+	Matrix < T > ghost;
+	MPI_Datatype column_type;
+	/* the edge rows and full-height columns of ghost, for fill_ghost_corners */
+	MPI_Datatype ring_row_type, ring_column_type;
+	MPI_Request halo[8];
+	/*
+		ghost buffers of the matrix powers kernel for depths up to deep_k, ping-ponged
+		between levels; entry j - 1 of the type lists exchanges depth j in them
+	*/
+	Matrix < T > deep[2];
+	int deep_k = 0;
+	vector < MPI_Datatype > deep_row_types, deep_column_types;
+
+	/* neighbours, local operator and halo buffers of the block */
+	void setup(const PoissonStencil < T >& A) {
+		MPI_Cart_shift(comm, 0, 1, &up, &down);
+		MPI_Cart_shift(comm, 1, 1, &left, &right);
+		/* blocks past the end of the grid are empty, nobody talks to them */
+		if (row_end == nx) down = MPI_PROC_NULL;
+		if (col_end == ny) right = MPI_PROC_NULL;
+		if (local_size() == 0) up = down = left = right = MPI_PROC_NULL;
+		stencil = PoissonStencil < T >(local_rows(), local_cols(), A.center, A.off);
+		ghost = Matrix < T >(local_rows() + 2, local_cols() + 2);
+		MPI_Type_vector(local_rows(), 1, local_cols() + 2, mpi_type<T>(), &column_type);
+		MPI_Type_commit(&column_type);
+		MPI_Type_vector(1, local_cols(), local_cols() + 2, mpi_type<T>(), &ring_row_type);
+		MPI_Type_commit(&ring_row_type);
+		MPI_Type_vector(local_rows() + 2, 1, local_cols() + 2, mpi_type<T>(), &ring_column_type);
+		MPI_Type_commit(&ring_column_type);
+	}
+
+	/*
+		grows the deep buffers and their datatypes to depth k; smaller depths run
+		inside them, so after the first outer step of a solve this does nothing
+	*/
+	void prepare_deep(int k) {
+		if (k <= deep_k) return;
+		free_deep_types();
+		deep_k = k;
+		int rows = local_rows(), cols = local_cols(), W = cols + 2 * k;
+		deep[0] = Matrix < T >(rows + 2 * k, W);
+		deep[1] = Matrix < T >(rows + 2 * k, W);
+		deep_row_types.resize(k), deep_column_types.resize(k);
+		for (int j = 1; j <= k; ++j) {
+			MPI_Type_vector(j, cols, W, mpi_type<T>(), &deep_row_types[j - 1]);
+			MPI_Type_commit(&deep_row_types[j - 1]);
+			MPI_Type_vector(rows + 2 * j, j, W, mpi_type<T>(), &deep_column_types[j - 1]);
+			MPI_Type_commit(&deep_column_types[j - 1]);
+		}
+	}
+
+	void free_deep_types() {
+		for (auto& t : deep_row_types) MPI_Type_free(&t);
+		for (auto& t : deep_column_types) MPI_Type_free(&t);
+		deep_row_types.clear(), deep_column_types.clear();
+	}
+
+	/*
+		k edge rows each way, then k full-height columns each way, in the buffer g
+		of row stride W with the block at (k, k); edge_rows and edge_columns are
+		the datatypes of k rows and k full-height columns of that layout
+	*/
+	void exchange_deep(T* g, int k, int W, MPI_Datatype edge_rows, MPI_Datatype edge_columns) {
+		int rows = local_rows(), cols = local_cols();
+		for (int p : { up, down }) if (p != MPI_PROC_NULL) count_sent((long long)k * cols * sizeof(T));
+		for (int p : { left, right }) if (p != MPI_PROC_NULL) count_sent((long long)k * (rows + 2 * k) * sizeof(T));
+		MPI_Sendrecv(g + k * W + k, 1, edge_rows, up, 5,
+			g + (rows + k) * W + k, 1, edge_rows, down, 5, comm, MPI_STATUS_IGNORE);
+		MPI_Sendrecv(g + rows * W + k, 1, edge_rows, down, 6,
+			g + k, 1, edge_rows, up, 6, comm, MPI_STATUS_IGNORE);
+		MPI_Sendrecv(g + k, 1, edge_columns, left, 7,
+			g + cols + k, 1, edge_columns, right, 7, comm, MPI_STATUS_IGNORE);
+		MPI_Sendrecv(g + cols, 1, edge_columns, right, 8,
+			g, 1, edge_columns, left, 8, comm, MPI_STATUS_IGNORE);
+	}
+
+	/* the local block of x into the interior of the ghost buffer */
+	void copy_to_ghost(const Matrix <T>& x) {
+		int rows = local_rows(), cols = local_cols(), w = cols + 2;
+		OMP(omp parallel for if(run_parallel(local_size())) schedule(static))
+		for (int i = 0; i < rows; ++i) {
+			std::copy(x.data() + i * cols, x.data() + (i + 1) * cols, ghost.data() + (i + 1) * w + 1);
+		}
+	}
+
+	/*
+		posts the halo exchange of the ghost buffer: edge rows are contiguous, edge
+		columns go out as one strided datatype. the sends read the block's edges and
+		the receives write only the ring, so the interior may be read meanwhile;
+		the ring is valid after finish_halo. corners are not exchanged
+	*/
+	void start_halo() {
+		int rows = local_rows(), cols = local_cols(), w = cols + 2;
+		T* g = ghost.data();
+		MPI_Irecv(g + (rows + 1) * w + 1, cols, mpi_type<T>(), down, 1, comm, &halo[0]);
+		MPI_Irecv(g + 1, cols, mpi_type<T>(), up, 2, comm, &halo[1]);
+		MPI_Irecv(g + w + cols + 1, 1, column_type, right, 3, comm, &halo[2]);
+		MPI_Irecv(g + w, 1, column_type, left, 4, comm, &halo[3]);
+		MPI_Isend(g + w + 1, cols, mpi_type<T>(), up, 1, comm, &halo[4]);
+		MPI_Isend(g + rows * w + 1, cols, mpi_type<T>(), down, 2, comm, &halo[5]);
+		MPI_Isend(g + w + 1, 1, column_type, left, 3, comm, &halo[6]);
+		MPI_Isend(g + w + cols, 1, column_type, right, 4, comm, &halo[7]);
+		for (int p : { up, down }) if (p != MPI_PROC_NULL) count_sent(cols * sizeof(T));
+		for (int p : { left, right }) if (p != MPI_PROC_NULL) count_sent(rows * sizeof(T));
+	}
+
+	void finish_halo() {
+		PhaseTimer timer(PHASE_WAIT);
+		MPI_Waitall(8, halo, MPI_STATUSES_IGNORE);
+	}
+};
+
+/* bytes [offset, offset + bytes) of an open MPI file, in chunks an int count can hold */
+inline bool read_file_range(MPI_File f, MPI_Offset offset, void* buffer, size_t bytes) {
+	const size_t chunk = 1 << 30;
+	char* out = (char*)buffer;
+	for (size_t done = 0; done < bytes; done += chunk) {
+		int count = (int)min(chunk, bytes - done);
+		MPI_Status status;
+		if (MPI_File_read_at(f, offset + done, out + done, count, MPI_BYTE, &status) != MPI_SUCCESS) return false;
+		int got;
+		MPI_Get_count(&status, MPI_BYTE, &got);
+		if (got != count) return false;
+	}
+	return true;
+}
+
+/*
+	a square sparse matrix distributed by contiguous row blocks: rank r owns rows
+	[starts[r], starts[r + 1]) and the matching slice of every vector. the local csr
+	has its columns renumbered, owned ones first ([0, local_size())), then the
+	ghosts, the off-rank columns the local rows touch, grouped by owner. the
+	exchange plan sends each neighbour exactly the entries it needs; apply() posts
+	it non-blocking and multiplies the rows without ghost columns meanwhile.
+	the same interface as DistributedPoisson (apply, sum, dot, local_size), so the
+	distributed CG runs on it unchanged.
+	the blocks are cut by the Partitioning: PARTITION_ROWS gives every rank the same
+	number of rows, PARTITION_NNZ the same number of nonzeros plus rows (the work of
+	a matvec and of the vector updates), so a few dense rows no longer leave one rank
+	with most of the work. PARTITION_GRAPH partitions the adjacency graph of the
+	matrix (graph_partition) on the master and renumbers the rows part by part, which
+	also cuts the ghost traffic of matrices whose numbering is not local; the
+	matrix and vectors the ranks hold are then those of P A P^T
+*/
+enum Partitioning { PARTITION_ROWS, PARTITION_NNZ, PARTITION_GRAPH };
+
+template <class T>
+class DistributedCsr {
+public:
+	MPI_Comm comm;
+	int rank, size, n = 0, row_begin = 0, row_end = 0;
+	Partitioning partitioning;
+	vector < int > starts;
+	/* PARTITION_GRAPH, master only: row i of the distributed matrix is row order[i] of the file */
+	vector < int > order;
+	Matrix_csr < T > local;
+	/* global index of every ghost column */
+	vector < int > ghost;
+	/* per neighbour: rank, count and offset of the ghosts it sends / the entries it receives */
+	vector < int > recv_ranks, recv_counts, recv_displs;
+	vector < int > send_ranks, send_counts, send_displs, send_index;
+	/* local rows that do not / do touch ghost columns */
+	vector < int > interior, boundary;
+
+	explicit DistributedCsr(MPI_Comm c, Partitioning p = PARTITION_NNZ) {
+		partitioning = p;
+		MPI_Comm_dup(c, &comm);
+		MPI_Comm_rank(comm, &rank);
+		MPI_Comm_size(comm, &size);
+	}
+
+	~DistributedCsr() {
+		MPI_Comm_free(&comm);
+	}
+
+	int local_size() const { return row_end - row_begin; }
+
+	/*
+		the matrix in path, each rank keeping its own rows. a binary file is read in
+		parallel with MPI-IO, every rank fetching only the header, its slice of
+		row_ptr and its range of col and val. a Matrix Market file is text and has to
+		be parsed in one place: the master reads it and scatters the row blocks; so
+		does the graph partitioning, which needs the whole matrix
+	*/
+	bool load(const string& path) {
+		bool on_master = has_extension(path, ".mtx") || partitioning == PARTITION_GRAPH;
+		bool ok = on_master ? load_on_master(path) : load_parallel(path);
+		int all;
+		int mine = ok;
+		MPI_Allreduce(&mine, &all, 1, MPI_INT, MPI_MIN, comm);
+		if (all) build_plan();
+		return all;
+	}
+
+	/*
+		this rank's slice of the vector in path. binary: MPI-IO of the slice only;
+		Matrix Market, or rows renumbered by the graph partitioning: read by the
+		master, permuted and scattered
+	*/
+	bool load_vector(const string& path, Matrix <T>& b) {
+		b = Matrix <T>(local_size(), 1);
+		int ok = 1;
+		if (!has_extension(path, ".mtx") && partitioning != PARTITION_GRAPH) {
+			MPI_File f;
+			BinaryHeader h;
+			ok = MPI_File_open(comm, path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &f) == MPI_SUCCESS;
+			if (ok) {
+				ok = read_file_range(f, 0, &h, sizeof(h)) && check_header(h, BINARY_VECTOR_MAGIC, path) && h.rows == n;
+				vector < char > raw(ok ? local_size() * h.scalar_size : 0);
+				ok = ok && read_file_range(f, sizeof(h) + (MPI_Offset)row_begin * h.scalar_size, raw.data(), raw.size());
+				if (ok) convert_scalars(raw.data(), h.scalar_size, b.data(), local_size());
+				MPI_File_close(&f);
+			}
+			else if (rank == MASTER) cout << path << ": cannot open" << endl;
+		}
+		else {
+			Matrix <T> full;
+			if (rank == MASTER) ok = read_vector(path, full) && (int)full.size() == n;
+			if (ok && !order.empty()) {
+				Matrix <T> permuted(n, 1);
+				for (int i = 0; i < n; ++i) permuted[i] = full[order[i]];
+				full = std::move(permuted);
+			}
+			MPI_Bcast(&ok, 1, MPI_INT, MASTER, comm);
+			if (ok) {
+				vector < int > counts(size), displs(starts.begin(), starts.end() - 1);
+				for (int r = 0; r < size; ++r) counts[r] = starts[r + 1] - starts[r];
+				MPI_Scatterv(full.data(), counts.data(), displs.data(), mpi_type<T>(),
+					b.data(), local_size(), mpi_type<T>(), MASTER, comm);
+			}
+		}
+		int all;
+		MPI_Allreduce(&ok, &all, 1, MPI_INT, MPI_MIN, comm);
+		if (!all && rank == MASTER) cout << path << ": no vector of length " << n << endl;
+		return all;
+	}
+
+	void apply(const Matrix <T>& x, Matrix <T>& y) {
+		PhaseTimer timer(PHASE_SPMV);
+		int own = local_size();
+		std::copy(x.data(), x.data() + own, ext.begin());
+		for (size_t i = 0; i < send_index.size(); ++i) send_buffer[i] = x[send_index[i]];
+		vector < MPI_Request >& req = requests;
+		req.clear();
+		for (size_t i = 0; i < recv_ranks.size(); ++i) {
+			req.emplace_back();
+			MPI_Irecv(ext.data() + own + recv_displs[i], recv_counts[i], mpi_type<T>(), recv_ranks[i], 9, comm, &req.back());
+		}
+		for (size_t i = 0; i < send_ranks.size(); ++i) {
+			req.emplace_back();
+			MPI_Isend(send_buffer.data() + send_displs[i], send_counts[i], mpi_type<T>(), send_ranks[i], 9, comm, &req.back());
+			count_sent(send_counts[i] * sizeof(T));
+		}
+		multiply_rows(interior, y);
+		{
+			PhaseTimer wait(PHASE_WAIT);
+			MPI_Waitall(req.size(), req.data(), MPI_STATUSES_IGNORE);
+		}
+		multiply_rows(boundary, y);
+	}
+
+	/* global sum of one partial value per rank, valid on every rank */
+	T sum(T local_value) {
+		PhaseTimer timer(PHASE_REDUCE);
+		count_sent(sizeof(T));
+		T global = 0;
+		MPI_Allreduce(&local_value, &global, 1, mpi_type<T>(), MPI_SUM, comm);
+		return global;
+	}
+
+	/* in-place global sum of count partial values */
+	void sum(T* values, int count) {
+		PhaseTimer timer(PHASE_REDUCE);
+		count_sent(count * sizeof(T));
+		MPI_Allreduce(MPI_IN_PLACE, values, count, mpi_type<T>(), MPI_SUM, comm);
+	}
+
+	T dot(const Matrix <T>& a, const Matrix <T>& b) {
+		return sum(::dot(a, b));
+	}
+
+private:
+	/* owned values followed by the ghosts, and the outgoing entries */
+	vector < T > ext, send_buffer;
+	vector < MPI_Request > requests;
+
+	void multiply_rows(const vector < int >& rows, Matrix <T>& y) const {
+		const T* x = ext.data();
+		OMP(omp parallel for if(run_parallel(rows.size() * 8)) schedule(static))
+		for (size_t i = 0; i < rows.size(); ++i) {
+			int r = rows[i];
+			T s = 0;
+			for (int k = local.row_ptr[r]; k < local.row_ptr[r + 1]; ++k) {
+				s += local.val[k] * x[local.col[k]];
+			}
+			y[r] = s;
+		}
+	}
+
+	/* balanced row blocks of an n x n matrix */
+	void set_rows(int rows) {
+		n = rows;
+		starts.resize(size + 1);
+		for (int r = 0; r < size; ++r) block_range(n, size, r, starts[r], starts[r + 1]);
+		row_begin = starts[rank], row_end = starts[rank + 1];
+	}
+
+	/*
+		PARTITION_NNZ: moves the block boundaries so that the ranks get equal shares
+		of the cost row_ptr[i] + i, total = nnz + n; the boundary of rank r is the
+		first row whose prefix cost reaches r / size of it. every rank searches the
+		entries of the global row_ptr it holds, row_ptr[first, first + size()), and
+		an Allreduce picks the earliest hit
+	*/
+	void balance_nonzeros(const vector < int64_t >& row_ptr, int first, int64_t total) {
+		vector < int > bound(size + 1, n);
+		bound[0] = 0;
+		for (int r = 1; r < size; ++r) {
+			int64_t target = total * r / size;
+			int lo = 0, hi = row_ptr.size();
+			while (lo < hi) {
+				int mid = (lo + hi) / 2;
+				if (row_ptr[mid] + first + mid >= target) hi = mid;
+				else lo = mid + 1;
+			}
+			if (lo < (int)row_ptr.size()) bound[r] = first + lo;
+		}
+		MPI_Allreduce(MPI_IN_PLACE, bound.data() + 1, size - 1, MPI_INT, MPI_MIN, comm);
+		starts = bound;
+		row_begin = starts[rank], row_end = starts[rank + 1];
+	}
+
+	bool load_parallel(const string& path) {
+		MPI_File f;
+		if (MPI_File_open(comm, path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &f) != MPI_SUCCESS) {
+			if (rank == MASTER) cout << path << ": cannot open" << endl;
+			return false;
+		}
+		BinaryHeader h;
+		bool ok = read_file_range(f, 0, &h, sizeof(h)) && check_header(h, BINARY_CSR_MAGIC, path);
+		if (ok && h.rows != h.cols) {
+			if (rank == MASTER) cout << path << ": matrix is not square" << endl;
+			ok = false;
+		}
+		if (ok) {
+			set_rows(h.rows);
+			CsrSections s = csr_sections(h);
+			int rows = local_size();
+			vector < int64_t > row_ptr(rows + 1);
+			ok = read_file_range(f, s.row_ptr + (MPI_Offset)row_begin * sizeof(int64_t), row_ptr.data(), (rows + 1) * sizeof(int64_t));
+			ok = ok && check_row_ptr(row_ptr.data(), rows, h.nnz, row_begin == 0, row_end == n, path);
+			if (partitioning == PARTITION_NNZ) {
+				/* the row-balanced slices cover row_ptr, find the new boundaries in them and read again */
+				int mine = ok, all;
+				MPI_Allreduce(&mine, &all, 1, MPI_INT, MPI_MIN, comm);
+				if (all) {
+					balance_nonzeros(row_ptr, row_begin, (int64_t)h.nnz + n);
+					rows = local_size();
+					row_ptr.resize(rows + 1);
+					ok = read_file_range(f, s.row_ptr + (MPI_Offset)row_begin * sizeof(int64_t), row_ptr.data(), (rows + 1) * sizeof(int64_t));
+					ok = ok && check_row_ptr(row_ptr.data(), rows, h.nnz, row_begin == 0, row_end == n, path);
+				}
+				else ok = false;
+			}
+			int64_t first = ok ? row_ptr[0] : 0, count = ok ? row_ptr[rows] - first : 0;
+			/* the whole file may hold more, but the local csr indexes its entries with int */
+			if (count > INT_MAX) {
+				cout << path << ": " << count << " entries on rank " << rank << ", more than an int indexes" << endl;
+				ok = false, count = 0;
+			}
+			local.n = rows, local.m = n;
+			local.row_ptr.resize(rows + 1);
+			for (int r = 0; r <= rows; ++r) local.row_ptr[r] = row_ptr[r] - first;
+			local.col.resize(count);
+			local.val.resize(count);
+			vector < char > raw(count * h.scalar_size);
+			bool fetched = ok && read_file_range(f, s.col + first * sizeof(int32_t), local.col.data(), count * sizeof(int32_t))
+				&& read_file_range(f, s.val + first * h.scalar_size, raw.data(), raw.size());
+			if (ok && !fetched) cout << path << ": read failed on rank " << rank << endl;
+			ok = fetched && check_columns(local.col.data(), count, n, path);
+			if (ok) convert_scalars(raw.data(), h.scalar_size, local.val.data(), count);
+		}
+		MPI_File_close(&f);
+		return ok;
+	}
+
+	bool load_on_master(const string& path) {
+		Matrix_csr < T > A;
+		int rows = 0;
+		if (rank == MASTER && read_matrix(path, A)) {
+			if (A.n == A.m) rows = A.n;
+			else cout << path << ": matrix is not square" << endl;
+		}
+		MPI_Bcast(&rows, 1, MPI_INT, MASTER, comm);
+		if (rows == 0) return false;
+		set_rows(rows);
+		if (partitioning == PARTITION_NNZ) {
+			vector < int64_t > row_ptr;
+			if (rank == MASTER) row_ptr.assign(A.row_ptr.begin(), A.row_ptr.end());
+			balance_nonzeros(row_ptr, 0, rank == MASTER ? (int64_t)A.nnz() + n : 0);
+		}
+		else if (partitioning == PARTITION_GRAPH) {
+			if (rank == MASTER) {
+				partition_order(graph_partition(A, size), size, order, starts);
+				A = permute_symmetric(A, order);
+			}
+			MPI_Bcast(starts.data(), size + 1, MPI_INT, MASTER, comm);
+			row_begin = starts[rank], row_end = starts[rank + 1];
+		}
+		/* row_ptr slices, then the entries of every block */
+		vector < int > counts(size), displs(size), entry_counts(size), entry_displs(size);
+		for (int r = 0; r < size; ++r) {
+			counts[r] = starts[r + 1] - starts[r] + 1, displs[r] = starts[r];
+			if (rank == MASTER) {
+				entry_displs[r] = A.row_ptr[starts[r]];
+				entry_counts[r] = A.row_ptr[starts[r + 1]] - entry_displs[r];
+			}
+		}
+		local.n = local_size(), local.m = n;
+		local.row_ptr.resize(local_size() + 1);
+		MPI_Scatterv(A.row_ptr.data(), counts.data(), displs.data(), MPI_INT,
+			local.row_ptr.data(), local_size() + 1, MPI_INT, MASTER, comm);
+		int first = local.row_ptr[0], count = local.row_ptr[local_size()] - first;
+		for (auto& p : local.row_ptr) p -= first;
+		local.col.resize(count);
+		local.val.resize(count);
+		MPI_Scatterv(A.col.data(), entry_counts.data(), entry_displs.data(), MPI_INT,
+			local.col.data(), count, MPI_INT, MASTER, comm);
+		MPI_Scatterv(A.val.data(), entry_counts.data(), entry_displs.data(), mpi_type<T>(),
+			local.val.data(), count, mpi_type<T>(), MASTER, comm);
+		return true;
+	}
+
+	/*
+		renumbers the local columns and sets up the exchange: the ghosts are sorted,
+		which groups them by owner, every owner is told which of its entries are
+		wanted (Alltoall of counts, Alltoallv of indices) and keeps them as send_index
+	*/
+	void build_plan() {
+		int own = local_size();
+		ghost.clear();
+		for (int c : local.col) {
+			if (c < row_begin || c >= row_end) ghost.push_back(c);
+		}
+		sort(ghost.begin(), ghost.end());
+		ghost.erase(unique(ghost.begin(), ghost.end()), ghost.end());
+		interior.clear(), boundary.clear();
+		for (int r = 0; r < own; ++r) {
+			bool touches = false;
+			for (int k = local.row_ptr[r]; k < local.row_ptr[r + 1]; ++k) {
+				int c = local.col[k];
+				if (c >= row_begin && c < row_end) local.col[k] = c - row_begin;
+				else local.col[k] = own + (lower_bound(ghost.begin(), ghost.end(), c) - ghost.begin()), touches = true;
+			}
+			(touches ? boundary : interior).push_back(r);
+		}
+		local.m = own + ghost.size();
+
+		vector < int > want(size, 0), give(size), want_displs(size, 0), give_displs(size, 0);
+		for (int c : ghost) want[upper_bound(starts.begin(), starts.end(), c) - starts.begin() - 1]++;
+		MPI_Alltoall(want.data(), 1, MPI_INT, give.data(), 1, MPI_INT, comm);
+		for (int r = 1; r < size; ++r) {
+			want_displs[r] = want_displs[r - 1] + want[r - 1];
+			give_displs[r] = give_displs[r - 1] + give[r - 1];
+		}
+		send_index.resize(give_displs[size - 1] + give[size - 1]);
+		MPI_Alltoallv(ghost.data(), want.data(), want_displs.data(), MPI_INT,
+			send_index.data(), give.data(), give_displs.data(), MPI_INT, comm);
+		for (auto& i : send_index) i -= row_begin;
+		recv_ranks.clear(), recv_counts.clear(), recv_displs.clear();
+		send_ranks.clear(), send_counts.clear(), send_displs.clear();
+		for (int r = 0; r < size; ++r) {
+			if (want[r]) recv_ranks.push_back(r), recv_counts.push_back(want[r]), recv_displs.push_back(want_displs[r]);
+			if (give[r]) send_ranks.push_back(r), send_counts.push_back(give[r]), send_displs.push_back(give_displs[r]);
+		}
+		ext.assign(local.m, T(0));
+		send_buffer.assign(send_index.size(), T(0));
+	}
+};
+
+/*
+	CG where every rank iterates on its own partition of x, r, p and Ap
+	(A is a DistributedPoisson or a DistributedCsr)
+	b and x are the local slices; returns the number of iterations and leaves
+	the final global r.r in rr. stops once ||r|| / ||b|| < tol
+*/
+template <class Distributed, class T>
+int distributed_conjugate_gradient(Distributed& A, Matrix <T>& b, Matrix <T>& X, T& rr, long double tol = EPS) {
+	int n = A.local_size(), itr = 0;
+	Matrix <T> R(n, 1), P(n, 1), AP(n, 1);
+	A.apply(X, AP);
+	for (int i = 0; i < n; ++i) {
+		R[i] = P[i] = b[i] - AP[i];
+	}
+	rr = A.dot(R, R);
+	T bb = A.dot(b, b);
+	while (sqrt(rr) / sqrt(bb) >= tol && itr < iteration_limit) {
+		++itr;
+		A.apply(P, AP);
+		T alpha = rr / A.dot(P, AP);
+		axpy(X, alpha, P);
+		T rr_new = A.sum(axpy_dot(R, -alpha, AP));
+		T beta = rr_new / rr;
+		xpay(P, beta, R);
+		rr = rr_new;
+		record_residual(sqrt(rr) / sqrt(bb));
+	}
+	return itr;
+}
+
+/*
+	solution recycling for sequences of solves with the same or a slowly varying
+	operator. W holds m vectors, A-orthonormalised (W^T A W = I), together with AW.
+	deflated CG keeps its search directions A-orthogonal to W, which takes the
+	eigencomponents W spans (the smallest ones, those that slow CG down) out of
+	the solve. the Ritz vectors come from the solves themselves, eigCG style
+	(Stathopoulos and Orginos): the normalised residuals are the Lanczos vectors
+	and the CG coefficients give the projected matrix, kept on a basis of at most
+	RECYCLE_WINDOW vectors that is thick-restarted onto its RECYCLE_KEEP smallest
+	Ritz vectors whenever it fills up. at the end of a solve the RECYCLE_HARVEST
+	smallest are appended to W; past RECYCLE_CAPACITY vectors W is compressed to
+	the RECYCLE_CAPACITY combinations with the smallest Rayleigh quotients (see
+	compress), whatever solve they came from
+*/
+const int RECYCLE_WINDOW = 32;
+const int RECYCLE_KEEP = 8;
+const int RECYCLE_HARVEST = 4;
+const int RECYCLE_CAPACITY = 16;
+
+/*
+	eigenvalues (ascending) and eigenvectors of the symmetric m x m a (row-major),
+	cyclic Jacobi; eigenvector j is column j of the row-major vecs
+*/
+template <class T>
+void symmetric_eigen(vector < T > a, int m, vector < T >& vals, vector < T >& vecs) {
+	vector < T > v(m * m, T(0));
+	for (int i = 0; i < m; ++i) v[i * m + i] = 1;
+	T norm = 0;
+	for (int i = 0; i < m * m; ++i) norm += a[i] * a[i];
+	for (int sweep = 0; sweep < 100; ++sweep) {
+		T off = 0;
+		for (int p = 0; p < m; ++p) {
+			for (int q = p + 1; q < m; ++q) off += a[p * m + q] * a[p * m + q];
+		}
+		if (off <= norm * numeric_limits<T>::epsilon() * numeric_limits<T>::epsilon()) break;
+		for (int p = 0; p < m; ++p) {
+			for (int q = p + 1; q < m; ++q) {
+				if (a[p * m + q] == 0) continue;
+				T theta = (a[q * m + q] - a[p * m + p]) / (2 * a[p * m + q]);
+				T t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+				T c = 1 / sqrt(t * t + 1), sn = t * c;
+				for (int k = 0; k < m; ++k) {
+					T kp = a[k * m + p], kq = a[k * m + q];
+					a[k * m + p] = c * kp - sn * kq;
+					a[k * m + q] = sn * kp + c * kq;
+				}
+				for (int k = 0; k < m; ++k) {
+					T pk = a[p * m + k], qk = a[q * m + k];
+					a[p * m + k] = c * pk - sn * qk;
+					a[q * m + k] = sn * pk + c * qk;
+				}
+				for (int k = 0; k < m; ++k) {
+					T kp = v[k * m + p], kq = v[k * m + q];
+					v[k * m + p] = c * kp - sn * kq;
+					v[k * m + q] = sn * kp + c * kq;
+				}
+			}
+		}
+	}
+	vector < int > order(m);
+	for (int i = 0; i < m; ++i) order[i] = i;
+	sort(order.begin(), order.end(), [&](int x, int y) { return a[x * m + x] < a[y * m + y]; });
+	vals.resize(m), vecs.resize(m * m);
+	for (int j = 0; j < m; ++j) {
+		vals[j] = a[order[j] * m + order[j]];
+		for (int i = 0; i < m; ++i) vecs[i * m + j] = v[i * m + order[j]];
+	}
+}
+
+template <class T>
+class RecycleSpace {
+public:
+	/* n x m, row-major: row i holds the m basis values of point i */
+	Matrix <T> W, AW;
+	int m = 0;
+	/* out = V^T v over the local rows (before the global sum) */
+	void project(const Matrix <T>& V, const Matrix <T>& v, T* out) const {
+		std::fill(out, out + m, T(0));
+		for (size_t i = 0; i < v.getRowSize(); ++i) {
+			for (int c = 0; c < m; ++c) out[c] += V[i * m + c] * v[i];
+		}
+	}
+
+	/* v = v + sign * V coef */
+	void combine(const Matrix <T>& V, const T* coef, Matrix <T>& v, T sign) const {
+		OMP(omp parallel for if(run_parallel(v.size() * m)) schedule(static))
+		for (size_t i = 0; i < v.getRowSize(); ++i) {
+			T s = 0;
+			for (int c = 0; c < m; ++c) s += V[i * m + c] * coef[c];
+			v[i] += sign * s;
+		}
+	}
+
+	/*
+		basis of the solve in progress and the projection of A onto it (row-major,
+		RECYCLE_WINDOW wide). couple[i] * -sqrt(beta) / alpha is the entry between
+		basis vector i and the next Lanczos vector: e_last for plain Lanczos, the
+		last components of the Ritz vectors after a restart
+	*/
+	vector < Matrix <T> > basis;
+	vector < T > H, couple;
+	T last_alpha = 0, last_beta = 0;
+
+	static void scale(Matrix <T>& v, T a) {
+		for (size_t i = 0; i < v.size(); ++i) v[i] *= a;
+	}
+
+	void begin_solve() {
+		basis.clear(), couple.clear();
+		H.assign(RECYCLE_WINDOW * RECYCLE_WINDOW, T(0));
+		last_alpha = 0;
+	}
+
+	/* Ritz pairs of the leading k x k block of H, ascending */
+	void ritz(int k, vector < T >& vals, vector < T >& vecs) const {
+		vector < T > h(k * k);
+		for (int i = 0; i < k; ++i) {
+			for (int j = 0; j < k; ++j) h[i * k + j] = H[i * RECYCLE_WINDOW + j];
+		}
+		symmetric_eigen(h, k, vals, vecs);
+	}
+
+	/* first keep Ritz vectors of the leading k basis vectors: V y_e for e < keep */
+	vector < Matrix <T> > ritz_vectors(int k, int keep, vector < T >& vals, vector < T >& vecs) const {
+		ritz(k, vals, vecs);
+		vector < Matrix <T> > out;
+		for (int e = 0; e < keep; ++e) {
+			out.emplace_back(basis[0].getRowSize(), 1);
+			for (int j = 0; j < k; ++j) axpy(out.back(), vecs[j * k + e], basis[j]);
+		}
+		return out;
+	}
+
+	/*
+		thick restart of a full basis: the RECYCLE_KEEP / 2 smallest Ritz vectors of
+		H and as many of its leading block without the newest vector (the previous
+		step's, as in eigCG) are orthonormalised and a Rayleigh-Ritz step on their
+		span gives the new basis, on which H is diagonal. returns its size
+	*/
+	int restart() {
+		int k = basis.size(), w = RECYCLE_WINDOW, nev = RECYCLE_KEEP / 2;
+		vector < T > vals, vecs, prev_vals, prev_vecs;
+		ritz(k, vals, vecs);
+		ritz(k - 1, prev_vals, prev_vecs);
+		vector < vector < T > > q;
+		for (int e = 0; e < 2 * nev; ++e) {
+			vector < T > z(k, T(0));
+			for (int i = 0; i < k; ++i) z[i] = e < nev ? vecs[i * k + e] : (i < k - 1 ? prev_vecs[i * (k - 1) + e - nev] : T(0));
+			for (int pass = 0; pass < 2; ++pass) {
+				for (auto& u : q) {
+					T c = 0;
+					for (int i = 0; i < k; ++i) c += u[i] * z[i];
+					for (int i = 0; i < k; ++i) z[i] -= c * u[i];
+				}
+			}
+			T norm = 0;
+			for (int i = 0; i < k; ++i) norm += z[i] * z[i];
+			if (!(sqrt(norm) > 1e-6)) continue;
+			for (int i = 0; i < k; ++i) z[i] /= sqrt(norm);
+			q.push_back(z);
+		}
+		int p = q.size();
+		vector < T > hq(p * p, T(0)), theta, y;
+		for (int a = 0; a < p; ++a) {
+			for (int b = 0; b < p; ++b) {
+				for (int i = 0; i < k; ++i) {
+					for (int j = 0; j < k; ++j) hq[a * p + b] += q[a][i] * H[i * w + j] * q[b][j];
+				}
+			}
+		}
+		symmetric_eigen(hq, p, theta, y);
+		vector < Matrix <T> > restarted;
+		H.assign(w * w, T(0));
+		couple.assign(p, T(0));
+		for (int e = 0; e < p; ++e) {
+			restarted.emplace_back(basis[0].getRowSize(), 1);
+			for (int i = 0; i < k; ++i) {
+				T c = 0;
+				for (int a = 0; a < p; ++a) c += q[a][i] * y[a * p + e];
+				axpy(restarted.back(), c, basis[i]);
+				if (i == k - 1) couple[e] = c;
+			}
+			H[e * w + e] = theta[e];
+		}
+		basis = restarted;
+		return p;
+	}
+
+	/* residual r with global r.r = rr becomes the next Lanczos vector */
+	void record(const Matrix <T>& r, T rr) {
+		if (!(rr > 0)) return;
+		int k = basis.size(), w = RECYCLE_WINDOW;
+		if (k == w) k = restart();
+		if (k > 0) {
+			T off = -sqrt(last_beta) / last_alpha;
+			for (int i = 0; i < k; ++i) H[i * w + k] = H[k * w + i] = couple[i] * off;
+		}
+		basis.push_back(r);
+		scale(basis.back(), 1 / sqrt(rr));
+		couple.assign(k + 1, T(0));
+		couple[k] = 1;
+	}
+
+	/* CG step coefficients: completes the diagonal entry of the newest Lanczos vector */
+	void record_step(T a, T b) {
+		int k = basis.size();
+		if (k == 0) return;
+		H[(k - 1) * RECYCLE_WINDOW + k - 1] = 1 / a + (last_alpha != 0 ? last_beta / last_alpha : T(0));
+		last_alpha = a, last_beta = b;
+	}
+
+	/*
+		Ritz vectors of the finished solve appended to the space; the newest basis
+		vector has no diagonal entry yet and is left out. apply(x, y) is y = A x and
+		sum(values, count) the in-place global sum, so it works on any partition
+	*/
+	template <class Apply, class Sum>
+	void harvest(Apply apply, Sum sum) {
+		int k = (int)basis.size() - 1;
+		if (k <= RECYCLE_HARVEST) return;
+		vector < T > vals, vecs;
+		vector < Matrix <T> > found = ritz_vectors(k, RECYCLE_HARVEST, vals, vecs);
+		begin_solve();
+		add(found, apply, sum);
+	}
+
+	/*
+		A-orthonormal w (aw = A w) cut down to the RECYCLE_CAPACITY combinations with
+		the smallest Rayleigh quotients: with w^T A w = I these are the eigenvectors of
+		the largest eigenvalues of the Gram matrix w^T w, and the combinations stay
+		A-orthonormal
+	*/
+	template <class Sum>
+	static void compress(vector < Matrix <T> >& w, vector < Matrix <T> >& aw, Sum sum) {
+		int q = w.size();
+		vector < T > g(q * q), mu, y;
+		for (int i = 0; i < q; ++i) {
+			for (int j = i; j < q; ++j) g[i * q + j] = dot(w[i], w[j]);
+		}
+		sum(g.data(), q * q);
+		for (int i = 0; i < q; ++i) {
+			for (int j = 0; j < i; ++j) g[i * q + j] = g[j * q + i];
+		}
+		symmetric_eigen(g, q, mu, y);
+		size_t n = w[0].getRowSize();
+		vector < Matrix <T> > kept, kept_a;
+		for (int e = q - 1; e >= q - RECYCLE_CAPACITY; --e) {
+			kept.emplace_back(n, 1), kept_a.emplace_back(n, 1);
+			for (int j = 0; j < q; ++j) {
+				axpy(kept.back(), y[j * q + e], w[j]);
+				axpy(kept_a.back(), y[j * q + e], aw[j]);
+			}
+		}
+		w = kept, aw = kept_a;
+	}
+
+	/*
+		vectors A-orthonormalised against the space (classical Gram-Schmidt, twice)
+		and appended; ones left with less than RECYCLE_DROP of their A-norm are
+		already spanned and skipped. past RECYCLE_CAPACITY the space is compressed
+	*/
+	template <class Apply, class Sum>
+	void add(vector < Matrix <T> >& vs, Apply apply, Sum sum) {
+		const T RECYCLE_DROP = 1e-6;
+		size_t n = vs.empty() ? 0 : vs[0].getRowSize();
+		vector < Matrix <T> > w, aw;
+		for (int c = 0; c < m; ++c) {
+			w.emplace_back(n, 1), aw.emplace_back(n, 1);
+			for (size_t i = 0; i < n; ++i) w[c][i] = W[i * m + c], aw[c][i] = AW[i * m + c];
+		}
+		for (auto& v : vs) {
+			Matrix <T> av(n, 1);
+			apply(v, av);
+			T norm0 = dot(v, av);
+			sum(&norm0, 1);
+			for (int pass = 0; pass < 2; ++pass) {
+				vector < T > coef(w.size());
+				for (size_t c = 0; c < w.size(); ++c) coef[c] = dot(aw[c], v);
+				if (!coef.empty()) sum(coef.data(), coef.size());
+				for (size_t c = 0; c < w.size(); ++c) {
+					axpy(v, -coef[c], w[c]);
+					axpy(av, -coef[c], aw[c]);
+				}
+			}
+			T norm = dot(v, av);
+			sum(&norm, 1);
+			if (!(norm > RECYCLE_DROP * norm0)) continue;
+			scale(v, 1 / sqrt(norm));
+			scale(av, 1 / sqrt(norm));
+			w.push_back(v), aw.push_back(av);
+		}
+		if (w.size() > (size_t)RECYCLE_CAPACITY) compress(w, aw, sum);
+		m = w.size();
+		W = Matrix <T>(n, m), AW = Matrix <T>(n, m);
+		for (int c = 0; c < m; ++c) {
+			for (size_t i = 0; i < n; ++i) W[i * m + c] = w[c][i], AW[i * m + c] = aw[c][i];
+		}
+	}
+};
+
+/*
+	deflated CG (Saad, Yeung, Erhel and Guyomarc'h) from the initial guess in X:
+	x0 gets the Galerkin correction on W, and every direction is made A-orthogonal
+	to W; the W^T A r of that step travels in the same reduction as r.r. without a
+	space (or with an empty one) it is plain CG from X. apply(x, y) is y = A x and
+	sum(values, count) the in-place global sum. the space, if given, harvests the
+	Ritz vectors of this solve at the end
+*/
+template <class T, class Apply, class Sum>
+int recycled_cg_solve(Apply apply, Sum sum, const Matrix <T>& b, Matrix <T>& X, T& rr, long double tol, RecycleSpace <T>* space) {
+	size_t n = b.getRowSize();
+	int m = space ? space->m : 0, itr = 0;
+	Matrix <T> R(n, 1), P(n, 1), AP(n, 1);
+	vector < T > red(m + 2);
+	apply(X, AP);
+	for (size_t i = 0; i < n; ++i) {
+		R[i] = b[i] - AP[i];
+	}
+	if (m) {
+		space->project(space->W, R, red.data());
+		sum(red.data(), m);
+		space->combine(space->W, red.data(), X, T(1));
+		space->combine(space->AW, red.data(), R, T(-1));
+	}
+	P = R;
+	if (m) {
+		space->project(space->AW, R, red.data());
+		sum(red.data(), m);
+		space->combine(space->W, red.data(), P, T(-1));
+	}
+	red[0] = dot(R, R), red[1] = dot(b, b);
+	sum(red.data(), 2);
+	rr = red[0];
+	T bb = red[1];
+	if (space) space->begin_solve(), space->record(R, rr);
+	while (sqrt(rr) / sqrt(bb) >= tol && itr < iteration_limit) {
+		++itr;
+		apply(P, AP);
+		T pap = dot(P, AP);
+		sum(&pap, 1);
+		T alpha = rr / pap;
+		axpy(X, alpha, P);
+		red[0] = axpy_dot(R, -alpha, AP);
+		if (m) space->project(space->AW, R, red.data() + 1);
+		sum(red.data(), m + 1);
+		T beta = red[0] / rr;
+		xpay(P, beta, R);
+		if (m) space->combine(space->W, red.data() + 1, P, T(-1));
+		if (space) space->record_step(alpha, beta), space->record(R, red[0]);
+		rr = red[0];
+		record_residual(sqrt(rr) / sqrt(bb));
+	}
+	if (space) space->harvest(apply, sum);
+	return itr;
+}
+
+/* recycled_cg_solve on the local slices of a DistributedPoisson, X is the (local) initial guess */
+template <class T>
+int distributed_recycled_conjugate_gradient(DistributedPoisson<T>& A, Matrix <T>& b, Matrix <T>& X, T& rr, RecycleSpace <T>* space, long double tol = EPS) {
+	auto apply = [&](const Matrix <T>& x, Matrix <T>& y) { A.apply(x, y); };
+	auto sum = [&](T* values, int count) { A.sum(values, count); };
+	return recycled_cg_solve(apply, sum, b, X, rr, tol, space);
+}
+
+/* relative change of the right-hand side per time step in distributed_time_steps */
+const double RECYCLE_DRIFT = 0.01;
+
+/*
+	steps solves of A x_t = b_t, b_t = b * (1 + RECYCLE_DRIFT * t * cos(g)) with g
+	the global point index: a slowly varying sequence like the load cases of a time
+	stepper. every solve starts from the previous solution and is deflated with the
+	Ritz vectors recycled from the ones before. X holds the last solution, the
+	return value is the total iteration count
+*/
+template <class T>
+int distributed_time_steps(DistributedPoisson<T>& A, Matrix <T>& b, Matrix <T>& X, T& rr, int steps, long double tol = EPS) {
+	int n = A.local_size(), cols = A.local_cols(), total = 0;
+	RecycleSpace <T> space;
+	Matrix <T> bt(n, 1);
+	for (int t = 0; t < steps; ++t) {
+		for (int l = 0; l < n; ++l) {
+			int g = map_to_int(A.row_begin + l / cols, A.col_begin + l % cols, A.nx, A.ny);
+			bt[l] = b[l] * T(1 + RECYCLE_DRIFT * t * cos((double)g));
+		}
+		int itr = distributed_recycled_conjugate_gradient(A, bt, X, rr, &space, tol);
+		total += itr;
+		if (A.rank == MASTER) cout << "Step " << t << ": " << itr << " iterations, " << space.m << " recycled vectors" << endl;
+	}
+	return total;
+}
+
+/*
+	distributed multigrid V-cycle for DistributedPoisson. every coarse level is a
+	DistributedPoisson on the same process grid whose blocks follow the fine ones
+	(coarse point (I, J) lives with fine point (2I + 1, 2J + 1)), so smoothing
+	(damped Jacobi), restriction and prolongation run on the rank blocks with
+	one-cell halo exchanges: per V-cycle a rank does O(n / P) work and sends
+	O(sqrt(n / P)) values on every level. coarsening stays distributed until the
+	next grid has at most MG_GATHER_SIZE points, a side shorter than 3 or a rank
+	without points; that grid is agglomerated on every rank with one Allgatherv
+	and the rest of the V-cycle (MultigridPreconditioner) runs redundantly on it,
+	at a cost bounded by MG_GATHER_SIZE whatever the fine grid.
+	fine grids with a side shorter than 3 have no coarse level and only get smoothed
+*/
+const int MG_GATHER_SIZE = 4096;
+
+template <class T>
+class DistributedMultigrid {
+public:
+	DistributedPoisson <T>& A;
+	int sweeps, cx, cy;
+	T omega;
+	/* the distributed coarse levels: levels[l - 1] is level l, A is level 0 */
+	std::deque < DistributedPoisson <T> > levels;
+	/* the cx x cy agglomerated grid below the last level, coarse points owned here: rows [I0, I1), columns [J0, J1) */
+	int I0 = 0, I1 = 0, J0 = 0, J1 = 0;
+	MultigridPreconditioner <T> coarse;
+
+	DistributedMultigrid(DistributedPoisson <T>& M, int nu = 2, T w = 0.8) : A(M) {
+		sweeps = nu, omega = w;
+		cx = cy = 0;
+		for (DistributedPoisson <T>* F = &A; min(F->nx, F->ny) >= 3; F = &levels.back()) {
+			int nx = (F->nx - 1) / 2, ny = (F->ny - 1) / 2;
+			coarse_block(*F, nx, ny, I0, I1, J0, J1);
+			int mine = (I1 - I0) * (J1 - J0) > 0, all;
+			MPI_Allreduce(&mine, &all, 1, MPI_INT, MPI_MIN, A.comm);
+			if (nx * ny <= MG_GATHER_SIZE || min(nx, ny) < 3 || !all) {
+				cx = nx, cy = ny;
+				break;
+			}
+			levels.emplace_back(PoissonStencil <T>(nx, ny, F->stencil.center / 4, F->stencil.off / 4), F->comm, I0, I1, J0, J1);
+		}
+		for (size_t l = 0; l <= levels.size(); ++l) {
+			int n = level(l).local_size();
+			x.push_back(Matrix <T>(n, 1));
+			b.push_back(Matrix <T>(n, 1));
+			r.push_back(Matrix <T>(n, 1));
+		}
+		if (cx > 0 && cy > 0) {
+			int mine[4] = { I0, I1, J0, J1 };
+			bounds.resize(4 * A.size);
+			counts.resize(A.size);
+			displs.assign(A.size, 0);
+			MPI_Allgather(mine, 4, MPI_INT, bounds.data(), 4, MPI_INT, A.comm);
+			for (int p = 0; p < A.size; ++p) {
+				counts[p] = (bounds[4 * p + 1] - bounds[4 * p]) * (bounds[4 * p + 3] - bounds[4 * p + 2]);
+				if (p > 0) displs[p] = displs[p - 1] + counts[p - 1];
+			}
+			const PoissonStencil <T>& S = level(levels.size()).stencil;
+			coarse = MultigridPreconditioner <T>(PoissonStencil <T>(cx, cy, S.center / 4, S.off / 4), nu, w);
+			local_rhs = Matrix <T>(counts[A.rank], 1);
+			gathered = Matrix <T>(cx * cy, 1);
+			rhs = Matrix <T>(cx * cy, 1);
+			xc = Matrix <T>(cx * cy, 1);
+		}
+	}
+
+	void apply(const Matrix <T>& rhs_fine, Matrix <T>& z) {
+		vcycle(0, rhs_fine, z);
+	}
+
+private:
+	vector < int > bounds, counts, displs;
+	/* per level work vectors: solution, right-hand side, residual (x and b unused on level 0) */
+	vector < Matrix <T> > x, b, r;
+	Matrix <T> local_rhs, gathered, rhs, xc;
+
+	DistributedPoisson <T>& level(size_t l) {
+		return l == 0 ? A : levels[l - 1];
+	}
+
+	/* the points of the nx x ny coarse grid whose fine point (2I + 1, 2J + 1) lies in F's block */
+	static void coarse_block(const DistributedPoisson <T>& F, int nx, int ny, int& i0, int& i1, int& j0, int& j1) {
+		i0 = F.row_begin / 2, i1 = max(i0, min(nx, F.row_end / 2));
+		j0 = F.col_begin / 2, j1 = max(j0, min(ny, F.col_end / 2));
+		if (F.local_size() == 0) i1 = i0, j1 = j0;
+	}
+
+	void vcycle(size_t l, const Matrix <T>& f, Matrix <T>& u) {
+		DistributedPoisson <T>& F = level(l);
+		int n = F.local_size();
+		bool bottom = l == levels.size();
+		smooth(l, f, u, true);
+		if (!bottom || (cx > 0 && cy > 0)) {
+			F.apply(u, r[l]);
+			for (int i = 0; i < n; ++i) r[l][i] = f[i] - r[l][i];
+			/* full weighting reaches diagonally, so the ring needs its corners */
+			const T* g = F.fill_ghost_corners(r[l]);
+			int stride = F.local_cols() + 2;
+			if (!bottom) {
+				DistributedPoisson <T>& C = levels[l];
+				restrict_full_weighting(g, stride, F.row_begin - 1, F.col_begin - 1, C.row_begin, C.row_end, C.col_begin, C.col_end, b[l + 1].data());
+				vcycle(l + 1, b[l + 1], x[l + 1]);
+				const T* gc = C.fill_ghost_corners(x[l + 1]);
+				prolong_bilinear_add(gc, C.local_cols() + 2, C.row_begin - 1, C.col_begin - 1, C.nx, C.ny,
+					F.row_begin, F.row_end, F.col_begin, F.col_end, u.data());
+			}
+			else {
+				restrict_full_weighting(g, stride, F.row_begin - 1, F.col_begin - 1, I0, I1, J0, J1, local_rhs.data());
+				count_sent((long long)counts[A.rank] * sizeof(T), A.size - 1);
+				MPI_Allgatherv(local_rhs.data(), counts[A.rank], mpi_type<T>(),
+					gathered.data(), counts.data(), displs.data(), mpi_type<T>(), A.comm);
+				for (int p = 0, k = 0; p < A.size; ++p) {
+					for (int I = bounds[4 * p]; I < bounds[4 * p + 1]; ++I) {
+						for (int J = bounds[4 * p + 2]; J < bounds[4 * p + 3]; ++J) rhs[I * cy + J] = gathered[k++];
+					}
+				}
+				coarse.apply(rhs, xc);
+				prolong_bilinear_add(xc.data(), cy, 0, 0, cx, cy, F.row_begin, F.row_end, F.col_begin, F.col_end, u.data());
+			}
+		}
+		smooth(l, f, u, false);
+	}
+
+	/* same damped Jacobi sweeps as MultigridPreconditioner, on the local blocks of level l */
+	void smooth(size_t l, const Matrix <T>& f, Matrix <T>& u, bool from_zero) {
+		DistributedPoisson <T>& F = level(l);
+		int n = F.local_size();
+		T w = omega / F.stencil.center;
+		for (int k = 0; k < sweeps; ++k) {
+			if (k == 0 && from_zero) {
+				for (int i = 0; i < n; ++i) u[i] = w * f[i];
+				continue;
+			}
+			F.apply(u, r[l]);
+			for (int i = 0; i < n; ++i) u[i] += w * (f[i] - r[l][i]);
+		}
+		if (sweeps == 0 && from_zero) std::fill(u.data(), u.data() + n, T(0));
+	}
+};
+
+/*
+	preconditioned version of distributed_conjugate_gradient, M is any
+	preconditioner with apply(r, z) on the local slices (DistributedMultigrid)
+*/
+template <class T, class Precond>
+int distributed_preconditioned_conjugate_gradient(DistributedPoisson<T>& A, Precond& M, Matrix <T>& b, Matrix <T>& X, T& rr, long double tol = EPS) {
+	int n = A.local_size(), itr = 0;
+	Matrix <T> R(n, 1), Z(n, 1), P(n, 1), AP(n, 1);
+	A.apply(X, AP);
+	for (int i = 0; i < n; ++i) {
+		R[i] = b[i] - AP[i];
+	}
+	{
+		PhaseTimer timer(PHASE_PRECOND);
+		M.apply(R, Z);
+	}
+	P = Z;
+	T rz = A.dot(R, Z), bb = A.dot(b, b);
+	rr = A.dot(R, R);
+	while (sqrt(rr) / sqrt(bb) >= tol && itr < iteration_limit) {
+		++itr;
+		A.apply(P, AP);
+		T alpha = rz / A.dot(P, AP);
+		axpy(X, alpha, P);
+		rr = A.sum(axpy_dot(R, -alpha, AP));
+		record_residual(sqrt(rr) / sqrt(bb));
+		{
+			PhaseTimer timer(PHASE_PRECOND);
+			M.apply(R, Z);
+		}
+		T rz_new = A.dot(R, Z);
+		xpay(P, rz_new / rz, Z);
+		rz = rz_new;
+	}
+	return itr;
+}
+
+/*
+	pipelined CG (Ghysels and Vanroose): the two inner products of an iteration,
+	r.r and w.r with w = A r, travel in a single MPI_Iallreduce that is in flight
+	while the next product q = A w is computed, so every iteration costs one
+	global reduction whose latency hides behind the SpMV. the recurrences for
+	w = A r, s = A p and z = A s replace the extra products.
+	those recurrences amplify rounding errors (badly so in float), so every
+	PIPELINED_REPLACE iterations r, w, s and z are recomputed from x and p. the
+	r.r after a replacement is the true residual, and the recurrence r.r it
+	replaces rides along in the next reduction. the CG residual is not monotone,
+	so one replacement without progress means nothing; only when PIPELINED_STALLS
+	replacements in a row find the true residual above both the best one so far
+	and the recurrence residual (which has run ahead into rounding noise) is the
+	attainable accuracy reached, and the loop stops with tol unmet; rr then
+	tells the caller. same interface as distributed_conjugate_gradient
+*/
+const int PIPELINED_REPLACE = 20;
+const int PIPELINED_STALLS = 3;
+
+template <class T>
+int distributed_pipelined_conjugate_gradient(DistributedPoisson<T>& A, Matrix <T>& b, Matrix <T>& X, T& rr, long double tol = EPS) {
+	int n = A.local_size(), itr = 0;
+	Matrix <T> R(n, 1), W(n, 1), Q(n, 1), P(n, 1), S(n, 1), Z(n, 1);
+	A.apply(X, Q);
+	for (int i = 0; i < n; ++i) {
+		R[i] = b[i] - Q[i];
+	}
+	A.apply(R, W);
+	T bb = A.dot(b, b), alpha = 0, gamma_old = 0, best_rr = -1;
+	/* r.r, w.r and the recurrence r.r before the last replacement */
+	T local[3] = { 0, 0, 0 }, global[3];
+	bool replaced = true;
+	int stalls = 0;
+	while (true) {
+		local[0] = dot(R, R);
+		local[1] = dot(W, R);
+		MPI_Request req = A.sum_async(local, global, 3);
+		A.apply(W, Q);
+		{
+			PhaseTimer wait(PHASE_WAIT);
+			MPI_Wait(&req, MPI_STATUS_IGNORE);
+		}
+		T gamma = global[0], delta = global[1];
+		rr = gamma;
+		if (itr > 0) record_residual(sqrt(rr) / sqrt(bb));
+		if (sqrt(gamma) / sqrt(bb) < tol || itr >= iteration_limit) break;
+		if (replaced) {
+			bool stalled = best_rr >= 0 && gamma >= best_rr && gamma > global[2];
+			stalls = stalled ? stalls + 1 : 0;
+			if (stalls >= PIPELINED_STALLS) break;
+			if (best_rr < 0 || gamma < best_rr) best_rr = gamma;
+			replaced = false;
+		}
+		T beta = 0;
+		if (itr == 0) {
+			alpha = gamma / delta;
+		}
+		else {
+			beta = gamma / gamma_old;
+			alpha = gamma / (delta - beta * gamma / alpha);
+		}
+		gamma_old = gamma;
+		++itr;
+		OMP(omp parallel for if(run_parallel(n)) schedule(static))
+		for (int i = 0; i < n; ++i) {
+			Z[i] = Q[i] + beta * Z[i];
+			S[i] = W[i] + beta * S[i];
+			P[i] = R[i] + beta * P[i];
+			X[i] += alpha * P[i];
+			R[i] -= alpha * S[i];
+			W[i] -= alpha * Z[i];
+		}
+		if (itr % PIPELINED_REPLACE == 0) {
+			local[2] = dot(R, R);
+			A.apply(X, Q);
+			for (int i = 0; i < n; ++i) {
+				R[i] = b[i] - Q[i];
+			}
+			A.apply(R, W);
+			A.apply(P, S);
+			A.apply(S, Z);
+			replaced = true;
+		}
+	}
+	return itr;
+}
+
+/*
+	s-step CG (Chronopoulos and Gear, in the form of Hoemmen / Carson): one outer
+	step takes s CG iterations from a single communication phase. the matrix powers
+	kernel builds the basis [p, A p, .., A^s p, r, A r, .., A^(s-1) r] (scaled by
+	sigma per power to keep it bounded), one Allreduce gives its Gram matrix G and
+	the s iterations then run on coefficient vectors of length 2s + 1 where every
+	inner product is u^T G v. per s iterations that is two halo exchanges and one
+	reduction instead of s exchanges and 2s reductions.
+	the monomial basis loses accuracy as s grows: when the Gram inner products
+	stop being positive the outer step is thrown away and redone with s halved,
+	when the rebuilt residual drifts from the recurrence the next steps use s / 2.
+	s stays reduced for the rest of the solve, s = 1 breaking down is a true CG
+	breakdown and ends it. s is clamped to the shortest block side
+*/
+const int SSTEP_DEFAULT = 4;
+
+template <class T>
+int distributed_sstep_conjugate_gradient(DistributedPoisson<T>& A, Matrix <T>& b, Matrix <T>& X, T& rr, long double tol = EPS, int s = SSTEP_DEFAULT) {
+	int n = A.local_size(), itr = 0;
+	s = max(1, min(s, A.halo_limit()));
+	T sigma = fabs(A.stencil.center) + 4 * fabs(A.stencil.off);
+	Matrix <T> R(n, 1), P(n, 1), AX(n, 1);
+	A.apply(X, AX);
+	R = b - AX;
+	P = R;
+	rr = A.dot(R, R);
+	T bb = A.dot(b, b);
+	vector < Matrix <T> > Vp, Vr;
+	while (sqrt(rr) / sqrt(bb) >= tol && itr < iteration_limit) {
+		int m = 2 * s + 1;
+		A.powers(P, s, sigma, Vp);
+		A.powers(R, s - 1, sigma, Vr);
+		/* basis vector i is Vp[i] for i <= s and Vr[i - s - 1] above */
+		auto basis = [&](int i) -> const Matrix <T>& { return i <= s ? Vp[i] : Vr[i - s - 1]; };
+
+		/* upper triangle of G in one reduction */
+		vector < T > g(m * (m + 1) / 2), G(m * m);
+		for (int i = 0, k = 0; i < m; ++i) {
+			for (int j = i; j < m; ++j) g[k++] = dot(basis(i), basis(j));
+		}
+		A.sum(g.data(), (int)g.size());
+		for (int i = 0, k = 0; i < m; ++i) {
+			for (int j = i; j < m; ++j, ++k) G[i * m + j] = G[j * m + i] = g[k];
+		}
+		/*
+			the coefficient recurrence predicted rr, G holds the true norm of the r
+			rebuilt from the last basis: a gap means that basis had lost accuracy
+		*/
+		T rr_basis = G[(s + 1) * m + s + 1];
+		bool drift = fabs(rr_basis - rr) > sqrt(numeric_limits<T>::epsilon()) * rr;
+		rr = rr_basis;
+		auto gdot = [&](const vector < T >& u, const vector < T >& v) {
+			T ret = 0;
+			for (int i = 0; i < m; ++i) {
+				for (int j = 0; j < m; ++j) ret += u[i] * G[i * m + j] * v[j];
+			}
+			return ret;
+		};
+
+		/* coefficients of p, r and the x update in the basis; A v_i = sigma v_(i+1) */
+		vector < T > p(m, 0), r(m, 0), x(m, 0), ap(m), r_new(m);
+		p[0] = 1, r[s + 1] = 1;
+		int steps = 0;
+		bool breakdown = false;
+		for (int j = 0; j < s && sqrt(rr) / sqrt(bb) >= tol && itr + steps < iteration_limit; ++j) {
+			std::fill(ap.begin(), ap.end(), T(0));
+			for (int i = 0; i < s; ++i) ap[i + 1] = sigma * p[i];
+			for (int i = s + 1; i < 2 * s; ++i) ap[i + 1] = sigma * p[i];
+			T pap = gdot(p, ap);
+			T alpha = rr / pap;
+			for (int i = 0; i < m; ++i) r_new[i] = r[i] - alpha * ap[i];
+			T rr_new = gdot(r_new, r_new);
+			if (!(pap > 0) || !(rr_new > 0) || !std::isfinite(rr_new)) {
+				breakdown = true;
+				break;
+			}
+			T beta = rr_new / rr;
+			for (int i = 0; i < m; ++i) {
+				x[i] += alpha * p[i];
+				p[i] = r_new[i] + beta * p[i];
+			}
+			r = r_new;
+			rr = rr_new;
+			++steps;
+			record_residual(sqrt(rr) / sqrt(bb));
+		}
+
+		/* back to full vectors: Vr[0] and Vp[0] hold copies of R and P */
+		if (!breakdown) {
+			std::fill(R.data(), R.data() + n, T(0));
+			std::fill(P.data(), P.data() + n, T(0));
+			for (int i = 0; i < m; ++i) {
+				axpy(X, x[i], basis(i));
+				axpy(R, r[i], basis(i));
+				axpy(P, p[i], basis(i));
+			}
+		}
+		if (breakdown) {
+			if (s == 1) break;
+			rr = rr_basis;
+		}
+		else {
+			itr += steps;
+		}
+		if ((breakdown || drift) && s > 1) s /= 2;
+	}
+	return itr;
+}
+
+/*
+	CG variant of the distributed solvers
+	CG_CLASSIC: distributed_conjugate_gradient, three blocking reductions per iteration
+	CG_PIPELINED: distributed_pipelined_conjugate_gradient, one overlapped reduction
+	CG_SSTEP: distributed_sstep_conjugate_gradient, one reduction per s iterations
+*/
+enum CgAlgorithm { CG_CLASSIC, CG_PIPELINED, CG_SSTEP };
+
+template <class T>
+int distributed_solve(CgAlgorithm algorithm, DistributedPoisson<T>& A, Matrix <T>& b, Matrix <T>& X, T& rr, long double tol = EPS, int s = SSTEP_DEFAULT) {
+	if (algorithm == CG_PIPELINED) return distributed_pipelined_conjugate_gradient(A, b, X, rr, tol);
+	if (algorithm == CG_SSTEP) return distributed_sstep_conjugate_gradient(A, b, X, rr, tol, s);
+	return distributed_conjugate_gradient(A, b, X, rr, tol);
+}
+
+/* tolerance of the Low precision correction solves and cap on refinement steps */
+const long double MIXED_INNER_EPS = 1e-5;
+const int MIXED_MAX_REFINEMENTS = 100;
+
+/*
+	mixed precision iterative refinement: each correction equation A d = r is
+	solved by distributed CG in Low precision (float) to MIXED_INNER_EPS, the
+	residual b - A x is recomputed in T (double) afterwards and the loop stops
+	on the same tol test as the plain solver. r is normalised before the cast so
+	the Low solve always sees O(1) values.
+	returns the number of refinement steps, inner_itr counts the Low CG iterations
+*/
+template <class Low, class T>
+int distributed_mixed_conjugate_gradient(DistributedPoisson<T>& A, DistributedPoisson<Low>& A_low, Matrix <T>& b, Matrix <T>& X, T& rr, int& inner_itr, CgAlgorithm algorithm = CG_CLASSIC, int s = SSTEP_DEFAULT, long double tol = EPS) {
+	int n = A.local_size(), outer = 0;
+	Matrix <T> R(n, 1), AX(n, 1);
+	Matrix <Low> r_low(n, 1), d_low(n, 1);
+	A.apply(X, AX);
+	R = b - AX;
+	rr = A.dot(R, R);
+	T bb = A.dot(b, b);
+	inner_itr = 0;
+	while (sqrt(rr) / sqrt(bb) >= tol && outer < MIXED_MAX_REFINEMENTS) {
+		++outer;
+		T scale = sqrt(rr);
+		r_low = (T(1) / scale) * R;
+		std::fill(d_low.data(), d_low.data() + n, Low(0));
+		Low rr_low;
+		inner_itr += distributed_solve(algorithm, A_low, r_low, d_low, rr_low, MIXED_INNER_EPS, s);
+		for (int i = 0; i < n; ++i) {
+			X[i] += scale * T(d_low[i]);
+		}
+		A.apply(X, AX);
+		R = b - AX;
+		rr = A.dot(R, R);
+	}
+	return outer;
+}
+
+/*
+	writes the instrumentation of the solve that just ended (see SolverStats) to
+	solver_stats.report_path on the master of comm: per rank the wall time of the
+	solve split into the phases plus "other" (everything outside them: scalar work,
+	loop control, load imbalance) and the bytes and messages it sent. a .csv path
+	gets one row per rank, anything else JSON that also carries the phase call
+	counts and the residual history. seconds is this rank's solve time. collective
+	over comm; does nothing while the instrumentation is off
+*/
+void finish_report(MPI_Comm comm, const string& solver, int itr, double seconds, long double rr) {
+	SolverStats& st = solver_stats;
+	if (!st.enabled) return;
+	int rank, size;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+	/* seconds, the phases, calls per phase, bytes, messages */
+	const int width = 2 * PHASE_COUNT + 3;
+	vector < double > mine(width), all(rank == MASTER ? width * size : 0);
+	mine[0] = seconds;
+	for (int p = 0; p < PHASE_COUNT; ++p) mine[1 + p] = st.seconds[p], mine[1 + PHASE_COUNT + p] = (double)st.calls[p];
+	mine[width - 2] = (double)st.bytes_sent, mine[width - 1] = (double)st.messages_sent;
+	MPI_Gather(mine.data(), width, MPI_DOUBLE, all.data(), width, MPI_DOUBLE, MASTER, comm);
+	if (rank != MASTER) return;
+
+	const string& path = st.report_path;
+	FILE* f = fopen(path.c_str(), "w");
+	if (!f) {
+		cout << path << ": cannot create" << endl;
+		return;
+	}
+	bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+	if (csv) {
+		fprintf(f, "rank,seconds");
+		for (int p = 0; p < PHASE_COUNT; ++p) fprintf(f, ",%s", phase_names[p]);
+		fprintf(f, ",other,bytes_sent,messages_sent\n");
+	}
+	else {
+		fprintf(f, "{\n  \"solver\": \"%s\",\n  \"ranks\": %d,\n  \"iterations\": %d,\n  \"error\": %.9Lg,\n  \"per_rank\": [",
+			solver.c_str(), size, itr, rr);
+	}
+	for (int r = 0; r < size; ++r) {
+		const double* row = all.data() + r * width;
+		double other = row[0];
+		for (int p = 0; p < PHASE_COUNT; ++p) other -= row[1 + p];
+		if (csv) {
+			fprintf(f, "%d,%.9g", r, row[0]);
+			for (int p = 0; p < PHASE_COUNT; ++p) fprintf(f, ",%.9g", row[1 + p]);
+			fprintf(f, ",%.9g,%.0f,%.0f\n", max(0.0, other), row[width - 2], row[width - 1]);
+			continue;
+		}
+		fprintf(f, "%s\n    {\"rank\": %d, \"seconds\": %.9g, \"phases\": {", r ? "," : "", r, row[0]);
+		for (int p = 0; p < PHASE_COUNT; ++p) fprintf(f, "\"%s\": %.9g, ", phase_names[p], row[1 + p]);
+		fprintf(f, "\"other\": %.9g}, \"calls\": {", max(0.0, other));
+		for (int p = 0; p < PHASE_COUNT; ++p) fprintf(f, "%s\"%s\": %.0f", p ? ", " : "", phase_names[p], row[1 + PHASE_COUNT + p]);
+		fprintf(f, "}, \"bytes_sent\": %.0f, \"messages_sent\": %.0f}", row[width - 2], row[width - 1]);
+	}
+	if (!csv) {
+		fprintf(f, "\n  ],\n  \"residual_history\": [");
+		for (size_t i = 0; i < st.residuals.size(); ++i) fprintf(f, "%s%.6e", i ? ", " : "", st.residuals[i]);
+		fprintf(f, "]\n}\n");
+	}
+	if (fclose(f) == 0) cout << "Report: " << path << endl;
+	else cout << path << ": write failed" << endl;
+}
+
+/*
+	precision the whole pipeline runs in
+	PRECISION_MIXED is float inner solves refined in double
+*/
+enum Precision { PRECISION_LONG_DOUBLE, PRECISION_DOUBLE, PRECISION_FLOAT, PRECISION_MIXED };
+
+/*
+	solver the driver runs on the generated problem
+	MODE_DISTRIBUTED: every rank keeps its blocks of the vectors (DistributedPoisson)
+	MODE_MASTER: the master/worker solver, the vectors live on the master
+	MODE_SERIAL: conjugate_gradient on the master alone
+*/
+enum RunMode { MODE_DISTRIBUTED, MODE_MASTER, MODE_SERIAL };
+
+/*
+	everything one run of the driver selects, filled in by set_option from the
+	command line and config files; the defaults are the distributed 40 x 40 run
+*/
+struct SolverConfig {
+	int nx = 40, ny = 40;
+	RunMode mode = MODE_DISTRIBUTED;
+	Precision precision = PRECISION_LONG_DOUBLE;
+	CgAlgorithm algorithm = CG_CLASSIC;
+	int s = SSTEP_DEFAULT;
+	/* operator of the serial solvers: stencil (matrix-free) or csr */
+	string op = "stencil";
+	string precond;
+	int rhs = 0, steps = 1;
+	long double tol = EPS;
+	/* 0 for no limit */
+	int max_iterations = 0;
+	unsigned seed = RHS_SEED;
+	/* OpenMP threads per rank: -1 keeps the serial backend, 0 takes the OpenMP default */
+	int threads = -1;
+	string simd;
+	string matrix_file, vector_file, write_matrix_file, write_vector_file, report_file;
+	/* row blocks of the --matrix solver */
+	Partitioning partition = PARTITION_NNZ;
+};
+
+void print_usage() {
+	cout << "options, as --key=value or as key = value lines of a --config=FILE:\n"
+		"  --nx=N --ny=N       grid of the generated problem (40 x 40), --grid=NxM sets both\n"
+		"  --mode=M            distributed (every rank keeps its vector blocks), master\n"
+		"                      (master/worker) or serial (the master alone)\n"
+		"  --precision=P       long, double, float or mixed (float solves refined in double)\n"
+		"  --algorithm=A       cg, pipelined or sstep, the CG variant of the distributed solver\n"
+		"  --s=N               steps per outer iteration of sstep\n"
+		"  --precond=NAME      jacobi, bjacobi, ssor, ic0, gs or mg: serial PCG on the master;\n"
+		"                      mg in distributed mode is the distributed multigrid PCG\n"
+		"  --operator=O        stencil or csr, the operator of the serial solvers\n"
+		"  --tol=X             stop at ||r|| / ||b|| < X (1e-10)\n"
+		"  --max-iterations=N  stop every CG loop after N iterations (0: no limit)\n"
+		"  --seed=N            seed of the generated right-hand sides\n"
+		"  --rhs=K             K right-hand sides at once with block CG on the master\n"
+		"  --steps=N           N slowly varying right-hand sides, each solve warm-started\n"
+		"                      and deflated with the Ritz vectors of the earlier ones (plain CG,\n"
+		"                      distributed or serial)\n"
+		"  --backend=B         serial or threads; --threads=N runs N OpenMP threads per rank\n"
+		"                      (0: the OpenMP default), so one rank per socket or node is enough\n"
+		"  --simd=L            scalar, avx2 or avx512, caps the vector kernels below the detected level\n"
+		"  --matrix=FILE       solve with the matrix in FILE (.mtx is Matrix Market, anything\n"
+		"                      else binary csr read in parallel); --vector=FILE reads b, else b = A * 1\n"
+		"  --partition=P       rows, nnz or graph: the row blocks of the --matrix solver get equal\n"
+		"                      rows, equal nonzeros (default) or come from a graph partitioning\n"
+		"  --write-matrix=FILE --write-vector=FILE  write the problem (or convert the --matrix /\n"
+		"                      --vector files) and exit\n"
+		"  --report=FILE       per-phase timing and residual history of the solve (.csv or JSON)\n"
+		"  --config=FILE       read options from FILE; later options override earlier ones" << endl;
+}
+
+inline string trim(const string& text) {
+	size_t begin = text.find_first_not_of(" \t\r\n");
+	if (begin == string::npos) return "";
+	return text.substr(begin, text.find_last_not_of(" \t\r\n") + 1 - begin);
+}
+
+/*
+	sets option key (without the leading --) to value. unknown keys and malformed
+	values return false, with the reason printed when verbose
+*/
+bool set_option(SolverConfig& c, const string& key, const string& value, bool verbose) {
+	auto to_int = [&](int& out, long low) {
+		char* end;
+		long v = strtol(value.c_str(), &end, 10);
+		if (value.empty() || *end || v < low || v > INT_MAX) return false;
+		out = (int)v;
+		return true;
+	};
+	bool ok = true;
+	if (key == "nx") ok = to_int(c.nx, 1);
+	else if (key == "ny") ok = to_int(c.ny, 1);
+	else if (key == "grid") {
+		size_t x = value.find('x');
+		ok = x != string::npos && set_option(c, "nx", value.substr(0, x), false) && set_option(c, "ny", value.substr(x + 1), false);
+	}
+	else if (key == "mode") {
+		if (value == "distributed") c.mode = MODE_DISTRIBUTED;
+		else if (value == "master") c.mode = MODE_MASTER;
+		else if (value == "serial") c.mode = MODE_SERIAL;
+		else ok = false;
+	}
+	else if (key == "precision") {
+		if (value == "long") c.precision = PRECISION_LONG_DOUBLE;
+		else if (value == "double") c.precision = PRECISION_DOUBLE;
+		else if (value == "float") c.precision = PRECISION_FLOAT;
+		else if (value == "mixed") c.precision = PRECISION_MIXED;
+		else ok = false;
+	}
+	else if (key == "algorithm") {
+		if (value == "cg") c.algorithm = CG_CLASSIC;
+		else if (value == "pipelined") c.algorithm = CG_PIPELINED;
+		else if (value == "sstep") c.algorithm = CG_SSTEP;
+		else ok = false;
+	}
+	else if (key == "s") ok = to_int(c.s, 1);
+	else if (key == "operator") {
+		ok = value == "stencil" || value == "csr";
+		if (ok) c.op = value;
+	}
+	else if (key == "precond") c.precond = value;
+	else if (key == "tol") {
+		char* end;
+		long double v = strtold(value.c_str(), &end);
+		ok = !value.empty() && !*end && v > 0;
+		if (ok) c.tol = v;
+	}
+	else if (key == "max-iterations") ok = to_int(c.max_iterations, 0);
+	else if (key == "seed") {
+		int seed;
+		ok = to_int(seed, 0);
+		if (ok) c.seed = (unsigned)seed;
+	}
+	else if (key == "rhs") ok = to_int(c.rhs, 0);
+	else if (key == "steps") ok = to_int(c.steps, 1);
+	else if (key == "threads") ok = to_int(c.threads, 0);
+	else if (key == "backend") {
+		if (value == "serial") c.threads = -1;
+		else if (value == "threads") c.threads = max(c.threads, 0);
+		else ok = false;
+	}
+	else if (key == "simd") {
+		ok = value == "scalar" || value == "avx2" || value == "avx512";
+		if (ok) c.simd = value;
+	}
+	else if (key == "matrix") c.matrix_file = value;
+	else if (key == "partition") {
+		if (value == "rows") c.partition = PARTITION_ROWS;
+		else if (value == "nnz") c.partition = PARTITION_NNZ;
+		else if (value == "graph") c.partition = PARTITION_GRAPH;
+		else ok = false;
+	}
+	else if (key == "vector") c.vector_file = value;
+	else if (key == "write-matrix") c.write_matrix_file = value;
+	else if (key == "write-vector") c.write_vector_file = value;
+	else if (key == "report") c.report_file = value;
+	else {
+		if (verbose) cout << "Unknown option: " << key << endl;
+		return false;
+	}
+	if (!ok && verbose) cout << "Bad value for " << key << ": '" << value << "'" << endl;
+	return ok;
+}
+
+/* options from a file, one key = value per line; blank lines and text after a # are skipped */
+bool load_config(SolverConfig& c, const string& path, bool verbose) {
+	FILE* f = fopen(path.c_str(), "r");
+	if (!f) {
+		if (verbose) cout << path << ": cannot open" << endl;
+		return false;
+	}
+	char line[4096];
+	bool ok = true;
+	for (int number = 1; ok && fgets(line, sizeof(line), f); ++number) {
+		string text = line;
+		text = text.substr(0, text.find('#'));
+		size_t eq = text.find('=');
+		if (trim(text).empty()) continue;
+		ok = eq != string::npos && set_option(c, trim(text.substr(0, eq)), trim(text.substr(eq + 1)), verbose);
+		if (!ok && verbose) cout << path << ":" << number << ": expected key = value with a known key" << endl;
+	}
+	fclose(f);
+	return ok;
+}
+
+/*
+	--key=value arguments in order, --config=FILE reads FILE at its place, so later
+	settings override earlier ones. false on the first bad one
+*/
+bool parse_arguments(SolverConfig& c, int argc, char* argv[], bool verbose) {
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg.compare(0, 2, "--") != 0) {
+			if (verbose) cout << "Unexpected argument: " << arg << endl;
+			return false;
+		}
+		size_t eq = arg.find('=');
+		string key = arg.substr(2, eq == string::npos ? string::npos : eq - 2);
+		string value = eq == string::npos ? "" : arg.substr(eq + 1);
+		if (!(key == "config" ? load_config(c, value, verbose) : set_option(c, key, value, verbose))) return false;
+	}
+	return true;
+}
+
+/*
+	smallest tol, in units of the epsilon of the working precision: below it the
+	recurrence residual of a float solve stops falling, CG runs to the iteration
+	limit and the deflated solves never end
+*/
+const int TOL_FLOOR_ULPS = 10;
+
+/*
+	options that do not go together are settled here, each with a message saying
+	which one gives way, instead of one of them being dropped silently
+*/
+void resolve_conflicts(SolverConfig& c, int size, bool verbose) {
+	auto note = [&](const char* text) { if (verbose) cout << text << endl; };
+	/* the mixed solver tests tol on its double residual */
+	long double floor = TOL_FLOOR_ULPS * (c.precision == PRECISION_FLOAT ? (long double)numeric_limits<float>::epsilon()
+		: c.precision == PRECISION_LONG_DOUBLE ? numeric_limits<long double>::epsilon() : (long double)numeric_limits<double>::epsilon());
+	if (c.tol < floor) {
+		if (verbose) cout << "--tol=" << (double)c.tol << " is below what this precision resolves, using " << (double)floor << endl;
+		c.tol = floor;
+	}
+	bool plain = c.precond.empty() && c.rhs == 0 && c.matrix_file.empty();
+	const SolverConfig defaults;
+	if (c.mode == MODE_MASTER && size < 2) {
+		note("The master/worker solver needs at least one worker, running the distributed solver");
+		c.mode = MODE_DISTRIBUTED;
+	}
+	if ((!c.write_matrix_file.empty() || !c.write_vector_file.empty()) && !c.report_file.empty()) {
+		note("--write-matrix and --write-vector only write the problem, --report ignored");
+	}
+	if (!c.matrix_file.empty() && c.mode != MODE_DISTRIBUTED) {
+		note("--matrix always runs the distributed solver, --mode ignored");
+		c.mode = MODE_DISTRIBUTED;
+	}
+	if (c.partition != defaults.partition && c.matrix_file.empty()) {
+		note("--partition splits the rows of a --matrix, ignored here");
+	}
+	/* block CG and every PCG but the distributed multigrid one run on the master alone */
+	bool master_only = c.matrix_file.empty() && (c.rhs > 0 || (!c.precond.empty() && !(c.precond == "mg" && c.mode == MODE_DISTRIBUTED)));
+	if (master_only && c.mode != MODE_SERIAL) {
+		if (verbose && size > 1) {
+			cout << (c.rhs > 0 ? string("--rhs") : "--precond=" + c.precond) << " runs serially on the master while the other ranks wait" << endl;
+		}
+		c.mode = MODE_SERIAL;
+	}
+	if (c.op != defaults.op && (c.mode != MODE_SERIAL || !c.matrix_file.empty())) {
+		note("--operator picks the operator of the serial solvers, ignored here");
+	}
+	if (c.precision == PRECISION_MIXED && c.mode == MODE_MASTER) {
+		note("Mixed precision needs the distributed or serial solver, running in double");
+		c.precision = PRECISION_DOUBLE;
+	}
+	if (c.precision == PRECISION_MIXED && (!plain || c.steps > 1)) {
+		note("Mixed precision runs plain CG only (no --precond, --rhs, --steps or --matrix), running in double");
+		c.precision = PRECISION_DOUBLE;
+	}
+	if (c.steps > 1 && (c.mode == MODE_MASTER || !plain)) {
+		note("Recycled time steps need plain distributed or serial CG (no --precond, --rhs or --matrix, no master mode), running one solve");
+		c.steps = 1;
+	}
+	if (c.s != defaults.s && c.algorithm != CG_SSTEP) {
+		note("--s sets the steps of --algorithm=sstep, ignored here");
+	}
+	bool distributed_cg = c.mode == MODE_DISTRIBUTED && plain && c.steps == 1;
+	if (c.algorithm != CG_CLASSIC && !distributed_cg) {
+		note("--algorithm picks the CG of the plain distributed solver, ignored here");
+		c.algorithm = CG_CLASSIC;
+	}
+}
+
+/*
+	distributed solve of the c.nx x c.ny problem: the master generates b once and
+	scatters it by grid blocks, every rank then solves on its own slices and the
+	solution is gathered back on the master at the end.
+	with Low different from T the solve runs as mixed precision refinement,
+	c.algorithm picks the CG variant (of the inner solves in mixed mode), c.s is the
+	step count of CG_SSTEP. precond mg runs PCG with DistributedMultigrid instead
+	(single precision runs only), steps > 1 runs distributed_time_steps instead
+*/
+template <class T, class Low = T>
+void run_distributed_solver(const SolverConfig& c) {
+	int nx = c.nx, ny = c.ny;
+	CgAlgorithm algorithm = c.algorithm;
+	DistributedPoisson<T> A(PoissonStencil < T >(nx, ny), MPI_COMM_WORLD);
+	vector < int > counts(A.size), displs(A.size), bounds(4 * A.size);
+	int local = A.local_size(), mine[4] = { A.row_begin, A.row_end, A.col_begin, A.col_end };
+	MPI_Allgather(&local, 1, MPI_INT, counts.data(), 1, MPI_INT, A.comm);
+	MPI_Allgather(mine, 4, MPI_INT, bounds.data(), 4, MPI_INT, A.comm);
+	for (int i = 1; i < A.size; ++i) displs[i] = displs[i - 1] + counts[i - 1];
+
+	/* block-ordered copy of a global vector: rank r's block starts at displs[r] */
+	Matrix <T> b_blocks, x_blocks;
+	if (A.rank == MASTER) {
+		auto b_full = generate_sparse_matrix<T>(nx, ny, c.seed).first;
+		b_blocks = x_blocks = Matrix <T>(nx * ny, 1);
+		for (int r = 0, k = 0; r < A.size; ++r) {
+			for (int i = bounds[4 * r]; i < bounds[4 * r + 1]; ++i) {
+				for (int j = bounds[4 * r + 2]; j < bounds[4 * r + 3]; ++j) {
+					b_blocks[k++] = b_full[map_to_int(i, j, nx, ny)];
+				}
+			}
+		}
+	}
+	Matrix <T> b(local, 1), X(local, 1);
+	MPI_Scatterv(b_blocks.data(), counts.data(), displs.data(), mpi_type<T>(),
+		b.data(), local, mpi_type<T>(), MASTER, A.comm);
+
+	if (A.rank == MASTER) cout << "..... Running Distributed Solver ....." << endl;
+	const char* const algorithm_names[] = { "cg", "pipelined", "sstep" };
+	string solver = algorithm_names[algorithm];
+	solver_stats.reset();
+	double begin = MPI_Wtime();
+	T rr;
+	int itr, refinements = 0;
+	if (std::is_same<T, Low>::value && c.steps > 1) {
+		solver = "recycled";
+		itr = distributed_time_steps(A, b, X, rr, c.steps, c.tol);
+	}
+	else if (std::is_same<T, Low>::value && c.precond == "mg") {
+		solver = "mg-pcg";
+		DistributedMultigrid<T> M(A);
+		itr = distributed_preconditioned_conjugate_gradient(A, M, b, X, rr, c.tol);
+	}
+	else if (std::is_same<T, Low>::value) {
+		itr = distributed_solve(algorithm, A, b, X, rr, c.tol, c.s);
+	}
+	else {
+		solver = "mixed-" + solver;
+		DistributedPoisson<Low> A_low(PoissonStencil < Low >(nx, ny), MPI_COMM_WORLD);
+		refinements = distributed_mixed_conjugate_gradient(A, A_low, b, X, rr, itr, algorithm, c.s, c.tol);
+	}
+	double end = MPI_Wtime();
+	/* a solver may stop short of tol (iteration limit, attainable accuracy); say so */
+	long double relative;
+	{
+		StatsPause pause;
+		Matrix <T> AX(local, 1);
+		A.apply(X, AX);
+		AX = b - AX;
+		relative = sqrt((long double)A.dot(AX, AX)) / sqrt((long double)A.dot(b, b));
+	}
+
+	MPI_Gatherv(X.data(), local, mpi_type<T>(),
+		x_blocks.data(), counts.data(), displs.data(), mpi_type<T>(), MASTER, A.comm);
+	if (A.rank == MASTER) {
+		cout << "Time Elapsed: " << end - begin << " sec" << endl;
+		cout << "Num. Iterations: " << itr << endl;
+		if (refinements) cout << "Refinement Steps: " << refinements << endl;
+		cout << "Error: " << rr << endl;
+		if (c.steps <= 1) report_convergence(relative, c.tol);
+	}
+	finish_report(A.comm, solver, itr, end - begin, rr);
+}
+
+/*
+	distributed CG on the matrix in c.matrix_file (binary csr or Matrix Market) with
+	b from c.vector_file; without a vector file b = A * 1, and the distance of x from
+	the all-ones solution is reported as well
+*/
+template <class T>
+void run_file_solver(const SolverConfig& c) {
+	const string& matrix_path = c.matrix_file;
+	const string& vector_path = c.vector_file;
+	DistributedCsr <T> A(MPI_COMM_WORLD, c.partition);
+	double load_begin = MPI_Wtime();
+	if (!A.load(matrix_path)) return;
+	int local = A.local_size();
+	Matrix <T> b(local, 1), X(local, 1), ones(local, 1);
+	for (int i = 0; i < local; ++i) ones[i] = 1;
+	if (vector_path.empty()) A.apply(ones, b);
+	else if (!A.load_vector(vector_path, b)) return;
+	double load_end = MPI_Wtime();
+	/* rows, entries and ghosts of this rank: the load balance and the halo volume of the partitioning */
+	long long mine[3] = { local, (long long)A.local.nnz(), (long long)A.ghost.size() }, low[3], high[3], total[3];
+	MPI_Reduce(mine, low, 3, MPI_LONG_LONG, MPI_MIN, MASTER, A.comm);
+	MPI_Reduce(mine, high, 3, MPI_LONG_LONG, MPI_MAX, MASTER, A.comm);
+	MPI_Reduce(mine, total, 3, MPI_LONG_LONG, MPI_SUM, MASTER, A.comm);
+
+	if (A.rank == MASTER) {
+		const char* partitions[] = { "rows", "nnz", "graph" };
+		cout << "..... Running Distributed Solver (" << A.n << " rows, " << total[1] << " entries) ....." << endl;
+		cout << "Load Time: " << load_end - load_begin << " sec" << endl;
+		cout << "Partition (" << partitions[A.partitioning] << "): " << low[0] << "-" << high[0] << " rows, "
+			<< low[1] << "-" << high[1] << " entries per rank, " << total[2] << " ghost values" << endl;
+	}
+	solver_stats.reset();
+	double begin = MPI_Wtime();
+	T rr;
+	int itr = distributed_conjugate_gradient(A, b, X, rr, c.tol);
+	double end = MPI_Wtime();
+	long double relative;
+	{
+		StatsPause pause;
+		Matrix <T> AX(local, 1);
+		A.apply(X, AX);
+		AX = b - AX;
+		relative = sqrt((long double)A.dot(AX, AX)) / sqrt((long double)A.dot(b, b));
+	}
+	T worst = 0, max_error;
+	for (int i = 0; i < local; ++i) worst = max(worst, (T)fabs(X[i] - 1));
+	MPI_Reduce(&worst, &max_error, 1, mpi_type<T>(), MPI_MAX, MASTER, A.comm);
+	if (A.rank == MASTER) {
+		cout << "Time Elapsed: " << end - begin << " sec" << endl;
+		cout << "Num. Iterations: " << itr << endl;
+		cout << "Error: " << rr << endl;
+		report_convergence(relative, c.tol);
+		if (vector_path.empty()) cout << "Max |x - 1|: " << max_error << endl;
+	}
+	finish_report(A.comm, "cg", itr, end - begin, rr);
+}
+
+/*
+	master only: writes the matrix and right-hand side to c.write_matrix_file /
+	c.write_vector_file (either may be empty), in the format their extension picks.
+	they are the ones in c.matrix_file / c.vector_file when given, else the generated
+	problem; so this also converts between Matrix Market and the binary format
+*/
+template <class T>
+void export_problem(const SolverConfig& c) {
+	const string& matrix_in = c.matrix_file;
+	const string& vector_in = c.vector_file;
+	const string& matrix_out = c.write_matrix_file;
+	const string& vector_out = c.write_vector_file;
+	auto t = generate_sparse_matrix<T>(c.nx, c.ny, c.seed);
+	Matrix_csr <T> A;
+	Matrix <T> b = t.first;
+	if (matrix_in.empty()) A = Matrix_csr <T>(t.second.to_coo());
+	else if (!read_matrix(matrix_in, A)) return;
+	if (!vector_in.empty() && !read_vector(vector_in, b)) return;
+	if (!matrix_out.empty() && write_matrix(matrix_out, A)) {
+		cout << "Wrote " << A.n << " x " << A.m << " matrix, " << A.nnz() << " entries, to " << matrix_out << endl;
+	}
+	if (!vector_out.empty() && write_vector(vector_out, b)) {
+		cout << "Wrote vector of length " << b.size() << " to " << vector_out << endl;
+	}
+}
+
+/*
+	master side of the master/worker solver: CG on A X = b from X = 0 until
+	||r|| / ||b|| < tol, with the workers of a world of size ranks sitting in
+	run_worker. one CG iteration is one OP_MATVEC and three batches: {r.r, p.Ap},
+	{x += alpha p, r -= alpha Ap, r.r} and {p = r + beta p}. the workers stay in
+	run_worker afterwards, shutdown_workers releases them.
+	returns the number of iterations, rr = r.r
+*/
+template <class T>
+int master_cg_solve(PoissonStencil <T>& A, const Matrix <T>& b, Matrix <T>& X, T& rr, int size, long double tol) {
+	Matrix <T> R(b), P(b);
+	Matrix <T> AP(b.getRowSize(), 1);
+	std::fill(X.data(), X.data() + X.size(), T(0));
+
+	int itr = 0, n = X.getRowSize();
+
+	T bb = dot(b, b);
+	rr = dot(R, R);
+	while (sqrt(rr) / sqrt(bb) >= tol && itr < iteration_limit) {
+		++itr;
+
+		// alpha = (trans(R) * R) / (trans(P) * A * P);
+		matrix_vector_mult_MASTER(AP, A, P, n);
+		WorkerBatch <T> step;
+		int r = step.add(R, BATCH_IN), p = step.add(P, BATCH_IN), ap = step.add(AP, BATCH_IN);
+		step.dot(r, r);
+		step.dot(p, ap);
+		vector < T > d = step.run(size);
+		rr = d[0];
+		T alpha = d[0] / d[1];
+
+		// X = X + alpha * P; R = R - alpha * A * P; trans(R) * R
+		WorkerBatch <T> update;
+		int x = update.add(X, BATCH_IN | BATCH_OUT);
+		r = update.add(R, BATCH_IN | BATCH_OUT), p = update.add(P, BATCH_IN), ap = update.add(AP, BATCH_IN);
+		update.axpy(x, x, alpha, p);
+		update.axpy(r, r, -alpha, ap);
+		update.dot(r, r);
+		T rr_new = update.run(size)[0];
+
+		// P = R + beta * P;
+		WorkerBatch <T> direction;
+		r = direction.add(R, BATCH_IN), p = direction.add(P, BATCH_IN | BATCH_OUT);
+		direction.axpy(p, r, rr_new / rr, p);
+		direction.run(size);
+		rr = rr_new;
+		record_residual(sqrt(rr) / sqrt(bb));
+	}
+	rr = dot(R, R);
+	return itr;
+}
+
+/* ends run_worker on every worker */
+inline void shutdown_workers() {
+	int op = OP_SHUTDOWN, zero = 0;
+	broadcast_header(op, zero);
+}
+
+/* master/worker solve of the generated problem, OP_SHUTDOWN releases the workers at the end */
+template <class T>
+void run_master_solver(const SolverConfig& c, int size) {
+	auto t = generate_sparse_matrix<T>(c.nx, c.ny, c.seed);
+	Matrix <T> X(t.first.getRowSize(), 1);
+	T rr;
+	cout << "..... Running Solver ....." << endl;
+	solver_stats.reset();
+	double begin = MPI_Wtime();
+	int itr = master_cg_solve(t.second, t.first, X, rr, size, c.tol);
+	double end = MPI_Wtime();
+	shutdown_workers();
+
+	cout << "Time Elapsed: " << end - begin << " sec" << endl;
+	cout << "Num. Iterations: " << itr << endl;
+	cout << "Error: " << rr << endl;
+	report_convergence(sqrt((long double)rr) / sqrt((long double)dot(t.first, t.first)), c.tol);
+	finish_report(MPI_COMM_WORLD, "master-cg", itr, end - begin, rr);
+}
+
+/* worker side of the master/worker solver: runs the commands the master sends until OP_SHUTDOWN */
+template <class T>
+void run_worker(int rank, int size) {
+	/* one signature for every command, a handler leaves out what it does not need */
+	typedef void (*Handler)(int rank, int size, int n);
+	static const Handler handlers[OP_COUNT] = { nullptr, matrix_vector_mult<T>, vector_batch<T> };
+	int operation = 0, n = 0;
+	/* the solve starts with the first command, the time between commands is wait */
+	double begin = 0, end = 0;
+
+	while (true) {
+		{
+			PhaseTimer wait(PHASE_WAIT);
+			broadcast_header(operation, n);
+		}
+		end = MPI_Wtime();
+		if (operation == OP_SHUTDOWN) break;
+		assert(operation > 0 && operation < OP_COUNT);
+		if (begin == 0) solver_stats.reset(), begin = end;
+		handlers[operation](rank, size, n);
+	}
+	finish_report(MPI_COMM_WORLD, "master-cg", 0, begin ? end - begin : 0, 0);
+}
+
+template <class T>
+void run_preconditioned_solver(const SolverConfig& c);
+template <class T>
+void run_block_solver(const SolverConfig& c);
+template <class T, class Low>
+void run_serial_solver(const SolverConfig& c);
+
+/*
+	runs what c selects on every rank, in T (Low is the inner precision of the mixed
+	solvers): export, file solve, block CG, serial PCG or the solver of c.mode.
+	the master-only ones leave the other ranks idle
+*/
+template <class T, class Low = T>
+void run_driver(const SolverConfig& c, int rank, int size) {
+	bool multigrid = c.precond == "mg" && c.mode == MODE_DISTRIBUTED;
+	if (!c.write_matrix_file.empty() || !c.write_vector_file.empty()) {
+		if (rank == MASTER) export_problem<T>(c);
+	}
+	else if (!c.matrix_file.empty()) {
+		run_file_solver<T>(c);
+	}
+	else if (c.rhs > 0) {
+		if (rank == MASTER) run_block_solver<T>(c);
+	}
+	else if (!c.precond.empty() && !multigrid) {
+		if (rank == MASTER) run_preconditioned_solver<T>(c);
+	}
+	else if (c.mode == MODE_DISTRIBUTED) {
+		run_distributed_solver<T, Low>(c);
+	}
+	else if (c.mode == MODE_SERIAL) {
+		if (rank == MASTER) run_serial_solver<T, Low>(c);
+	}
+	else if (rank == MASTER) {
+		run_master_solver<T>(c, size);
+	}
+	else {
+		run_worker<T>(rank, size);
+	}
+}
+
+/* programs that build on this file (the benchmark suite) define CG_NO_MAIN before including it */
+#ifndef CG_NO_MAIN
+int main(int argc, char* argv[]) {
+
+	int rank, size, provided;
+	/* threads only compute between MPI calls, all communication stays on the main thread */
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+	/* every option is listed by print_usage, --help */
+	for (int i = 1; i < argc; ++i) {
+		if (string(argv[i]) == "--help") {
+			if (rank == MASTER) print_usage();
+			MPI_Finalize();
+			return 0;
+		}
+	}
+	SolverConfig config;
+	if (!parse_arguments(config, argc, argv, rank == MASTER)) {
+		if (rank == MASTER) cout << "--help lists the options" << endl;
+		MPI_Finalize();
+		return 1;
+	}
+	set_iteration_limit(config.max_iterations);
+	if (!config.simd.empty()) {
+		SimdLevel wanted = config.simd == "avx512" ? SIMD_AVX512 : config.simd == "avx2" ? SIMD_AVX2 : SIMD_SCALAR;
+		set_simd(wanted);
+		if (simd_level < wanted && rank == MASTER) cout << "The CPU (or build) has no " << config.simd << ", running the best level below it" << endl;
+	}
+	if (!config.report_file.empty()) set_stats(config.report_file);
+	if (config.threads >= 0) {
+		if (provided < MPI_THREAD_FUNNELED) {
+			if (rank == MASTER) cout << "MPI library without MPI_THREAD_FUNNELED, running single-threaded" << endl;
+		}
+		else {
+			set_backend(BACKEND_THREADS, config.threads);
+#ifdef _OPENMP
+			if (rank == MASTER) cout << "Hybrid mode: " << size << " ranks x " << omp_get_max_threads() << " threads" << endl;
+#endif
+		}
+	}
+	resolve_conflicts(config, size, rank == MASTER);
+
+	if (config.precision == PRECISION_MIXED) run_driver<double, float>(config, rank, size);
+	else if (config.precision == PRECISION_DOUBLE) run_driver<double>(config, rank, size);
+	else if (config.precision == PRECISION_FLOAT) run_driver<float>(config, rank, size);
+	else run_driver<long double>(config, rank, size);
+
+	MPI_Finalize();
+	return 0;
+}
+#endif
+
+/* a^T * A * b for any operator A that supports A * Matrix */
+template <class Operator, class T>
+T Adot(Matrix<T>& a, Operator& A, Matrix<T>& b) {
+	return dot(a, A * b);
+}
+
+/*
+	CG iterations on A X = b starting from the X passed in, until ||r|| / ||b|| < tol
+	A can be any operator with a multiply() overload: Matrix_csr, PoissonStencil, ...
+	the loop runs on four preallocated vectors with one operator product per
+	iteration; A * P is reused for the alpha denominator and the residual update.
+	returns the number of iterations
+*/
+template <class Operator, class T>
+int cg_solve(Operator& A, const Matrix <T>& b, Matrix <T>& X, long double tol) {
+	size_t n = b.getRowSize();
+	Matrix <T> R(n, 1), P(n, 1), AP(n, 1);
+	int itr = 0;
+	multiply(A, X, AP);
+	for (size_t i = 0; i < n; ++i) {
+		R[i] = P[i] = b[i] - AP[i];
+	}
+	T rr = dot(R, R), bb = dot(b, b);
+	while (sqrt(rr) / sqrt(bb) >= tol && itr < iteration_limit) {
+		++itr;
+		multiply(A, P, AP);
+		T alpha = rr / dot(P, AP);
+		axpy(X, alpha, P);
+		T rr_new = axpy_dot(R, -alpha, AP);
+		T beta = rr_new / rr;
+		xpay(P, beta, R);
+		rr = rr_new;
+		record_residual(sqrt(rr) / sqrt(bb));
+	}
+	return itr;
+}
+
+template <class Operator, class T>
+Matrix <T> conjugate_gradient(Operator& A, Matrix <T>& b, long double tol = EPS) {
+	clock_t begin = clock();
+	size_t n = b.getRowSize();
+	Matrix <T> X(n, 1), AP(n, 1);
+	cout << "..... Running Normal Solver ....." << endl;
+	solver_stats.reset();
+	double wall = MPI_Wtime();
+	int itr = cg_solve(A, b, X, tol);
+	wall = MPI_Wtime() - wall;
+	clock_t end = clock();
+	double elapsed_secs = double(end - begin) / CLOCKS_PER_SEC;
+	T rr;
+	{
+		StatsPause pause;
+		multiply(A, X, AP);
+		rr = dot(b - AP, b - AP);
+	}
+	cout << "Time Elapsed: " << elapsed_secs << " sec" << endl;
+	cout << "Iterations: " << itr << endl;
+	cout << "Absolute Error: " << rr << endl;
+	report_convergence(sqrt((long double)rr) / sqrt((long double)dot(b, b)), tol);
+	finish_report(MPI_COMM_SELF, "cg", itr, wall, rr);
+	cout << endl;
+	return X;
+}
+
+/*
+	CG on A X = B for all k columns of the n x k B at once. every iteration does one
+	operator sweep for the k search directions (SpMM) and gets the k values of each
+	inner product from one pass (column_dots); the recurrences stay per column, so
+	each column follows exactly the iterates of its own CG solve. a column stops
+	updating once its ||r|| / ||b|| < tol, the loop ends when all have.
+	returns the iteration count of the slowest column, per-column counts in its
+*/
+template <class Operator, class T>
+int cg_solve_block(Operator& A, const Matrix <T>& B, Matrix <T>& X, long double tol, vector < int >& its) {
+	size_t n = B.getRowSize(), k = B.getColSize();
+	Matrix <T> R(n, k), P(n, k), AP(n, k);
+	vector < T > rr(k), bb(k), pap(k), alpha(k), beta(k), rr_new(k);
+	vector < char > active(k);
+	its.assign(k, 0);
+	multiply(A, X, AP);
+	for (size_t i = 0; i < n * k; ++i) {
+		R[i] = P[i] = B[i] - AP[i];
+	}
+	column_dots(R, R, rr.data());
+	column_dots(B, B, bb.data());
+	int itr = 0;
+	while (true) {
+		bool any = false;
+		for (size_t c = 0; c < k; ++c) {
+			active[c] = bb[c] > 0 && sqrt(rr[c]) / sqrt(bb[c]) >= tol;
+			any = any || active[c];
+		}
+		if (!any || itr >= iteration_limit) break;
+		++itr;
+		multiply(A, P, AP);
+		column_dots(P, AP, pap.data());
+		for (size_t c = 0; c < k; ++c) alpha[c] = active[c] ? rr[c] / pap[c] : T(0);
+		column_axpy(X, alpha.data(), P);
+		for (size_t c = 0; c < k; ++c) alpha[c] = -alpha[c];
+		column_axpy_dot(R, alpha.data(), AP, rr_new.data());
+		long double worst = 0;
+		for (size_t c = 0; c < k; ++c) {
+			beta[c] = active[c] ? rr_new[c] / rr[c] : T(0);
+			if (active[c]) rr[c] = rr_new[c], its[c]++;
+			if (bb[c] > 0) worst = max(worst, sqrt((long double)rr[c]) / sqrt((long double)bb[c]));
+		}
+		record_residual(worst);
+		column_xpay(P, beta.data(), R);
+	}
+	return itr;
+}
+
+/* multiple right-hand side solve, one solution column per column of B */
+template <class Operator, class T>
+Matrix <T> block_conjugate_gradient(Operator& A, Matrix <T>& B, long double tol = EPS) {
+	clock_t begin = clock();
+	size_t n = B.getRowSize(), k = B.getColSize();
+	Matrix <T> X(n, k), AX(n, k);
+	vector < int > its;
+	vector < T > err(k);
+	cout << "..... Running Block Solver (" << k << " right-hand sides) ....." << endl;
+	solver_stats.reset();
+	double wall = MPI_Wtime();
+	int itr = cg_solve_block(A, B, X, tol, its);
+	wall = MPI_Wtime() - wall;
+	clock_t end = clock();
+	double elapsed_secs = double(end - begin) / CLOCKS_PER_SEC;
+	{
+		StatsPause pause;
+		multiply(A, X, AX);
+		AX = B - AX;
+		column_dots(AX, AX, err.data());
+	}
+	cout << "Time Elapsed: " << elapsed_secs << " sec" << endl;
+	cout << "Iterations: " << itr << endl;
+	cout << "Absolute Error: " << *max_element(err.begin(), err.end()) << endl;
+	/* the worst column decides */
+	vector < T > bb(k);
+	column_dots(B, B, bb.data());
+	long double worst = 0;
+	for (size_t j = 0; j < k; ++j) worst = max(worst, sqrt((long double)err[j]) / sqrt((long double)bb[j]));
+	report_convergence(worst, tol);
+	finish_report(MPI_COMM_SELF, "block-cg", itr, wall, *max_element(err.begin(), err.end()));
+	cout << endl;
+	return X;
+}
+
+/*
+	CG from the X passed in (e.g. the previous solution of a time stepper), deflated
+	with and harvesting into space when one is given; see recycled_cg_solve.
+	returns the number of iterations, rr = ||b - A X||^2 of the result
+*/
+template <class Operator, class T>
+int conjugate_gradient(Operator& A, Matrix <T>& b, Matrix <T>& X, T& rr, RecycleSpace <T>* space = nullptr, long double tol = EPS) {
+	clock_t begin = clock();
+	size_t n = b.getRowSize();
+	Matrix <T> AP(n, 1);
+	cout << "..... Running Recycled Solver (" << (space ? space->m : 0) << " deflation vectors) ....." << endl;
+	auto apply = [&](const Matrix <T>& x, Matrix <T>& y) { multiply(A, x, y); };
+	auto sum = [](T*, int) {};
+	int itr = recycled_cg_solve(apply, sum, b, X, rr, tol, space);
+	clock_t end = clock();
+	double elapsed_secs = double(end - begin) / CLOCKS_PER_SEC;
+	{
+		StatsPause pause;
+		multiply(A, X, AP);
+		rr = dot(b - AP, b - AP);
+	}
+	cout << "Time Elapsed: " << elapsed_secs << " sec" << endl;
+	cout << "Iterations: " << itr << endl;
+	cout << "Absolute Error: " << rr << endl;
+	report_convergence(sqrt((long double)rr) / sqrt((long double)dot(b, b)), tol);
+	cout << endl;
+	return itr;
+}
+
+/*
+	serial counterpart of distributed_time_steps: steps solves with the drifting
+	right-hand sides b_t, each warm-started from the previous solution and deflated
+	with the Ritz vectors recycled so far; the report covers all of them.
+	returns the last solution
+*/
+template <class Operator, class T>
+Matrix <T> time_steps(Operator& A, const Matrix <T>& b, int steps, long double tol = EPS) {
+	size_t n = b.getRowSize();
+	RecycleSpace <T> space;
+	Matrix <T> X(n, 1), bt(n, 1);
+	T rr = 0;
+	int total = 0;
+	solver_stats.reset();
+	double wall = MPI_Wtime();
+	for (int t = 0; t < steps; ++t) {
+		for (size_t g = 0; g < n; ++g) bt[g] = b[g] * T(1 + RECYCLE_DRIFT * t * cos((double)g));
+		cout << "Step " << t << ":" << endl;
+		total += conjugate_gradient(A, bt, X, rr, &space, tol);
+	}
+	wall = MPI_Wtime() - wall;
+	finish_report(MPI_COMM_SELF, "recycled", total, wall, rr);
+	return X;
 }
 
+/* COO input is converted to CSR once so every product in the loop is a CSR SpMV */
 template <class T>
-Matrix <T> preconditioned_conjugate_gradient(Matrix_coo<T>& B, Matrix_coo<T>& A, Matrix <T>& b) {
+Matrix <T> conjugate_gradient(Matrix_coo <T>& A, Matrix <T>& b, long double tol = EPS) {
+	Matrix_csr <T> C(A);
+	return conjugate_gradient(C, b, tol);
+}
+
+/*
+	mixed precision iterative refinement on one node: correction equations are
+	solved by cg_solve in Low precision on a Low copy of the operator, the residual
+	is recomputed in T and the loop stops on the same tol test as conjugate_gradient
+*/
+template <class Low, class Operator, class T>
+Matrix <T> mixed_precision_conjugate_gradient(Operator& A, Matrix <T>& b, long double tol = EPS) {
 	clock_t begin = clock();
-	Matrix <T> R0(b.getRowSize(), 1), R1(b.getRowSize(), 1);
-	Matrix <T> P0(b.getRowSize(), 1), P1(b.getRowSize(), 1);
-	Matrix <T> X0(b.getRowSize(), 1), X1(b.getRowSize(), 1);
-	Matrix <T> Z0(b.getRowSize(), 1), Z1(b.getRowSize(), 1);
-	Matrix <T> br(b.getRowSize(), 1);
+	size_t n = b.getRowSize();
+	auto A_low = cast_operator<Low>(A);
+	Matrix <T> X(n, 1), R(b), AX(n, 1);
+	Matrix <Low> r_low(n, 1), d_low(n, 1);
+	int itr = 0, outer = 0;
+	cout << "..... Running Mixed Precision Solver ....." << endl;
+	solver_stats.reset();
+	double wall = MPI_Wtime();
+	T rr = dot(R, R), bb = dot(b, b);
+	while (sqrt(rr) / sqrt(bb) >= tol && outer < MIXED_MAX_REFINEMENTS) {
+		++outer;
+		T scale = sqrt(rr);
+		r_low = (T(1) / scale) * R;
+		std::fill(d_low.data(), d_low.data() + n, Low(0));
+		itr += cg_solve(A_low, r_low, d_low, MIXED_INNER_EPS);
+		for (size_t i = 0; i < n; ++i) {
+			X[i] += scale * T(d_low[i]);
+		}
+		multiply(A, X, AX);
+		R = b - AX;
+		rr = dot(R, R);
+	}
+	wall = MPI_Wtime() - wall;
+	clock_t end = clock();
+	double elapsed_secs = double(end - begin) / CLOCKS_PER_SEC;
+	cout << "Time Elapsed: " << elapsed_secs << " sec" << endl;
+	cout << "Iterations: " << itr << endl;
+	cout << "Refinement Steps: " << outer << endl;
+	cout << "Absolute Error: " << rr << endl;
+	report_convergence(sqrt((long double)rr) / sqrt((long double)bb), tol);
+	finish_report(MPI_COMM_SELF, "mixed-cg", itr, wall, rr);
+	cout << endl;
+	return X;
+}
+
+/*
+	same loop as cg_solve with z = M^-1 r applied to every new residual, from the X
+	passed in until ||r|| / ||b|| < tol. B is any preconditioner with apply(r, z),
+	see JacobiPreconditioner and friends. returns the number of iterations, rr = r.r
+*/
+template <class Precond, class Operator, class T>
+int pcg_solve(Precond& B, Operator& A, const Matrix <T>& b, Matrix <T>& X, T& rr, long double tol) {
+	size_t n = b.getRowSize();
+	Matrix <T> R(n, 1), P(n, 1), Z(n, 1), AP(n, 1);
 	int itr = 0;
-	R0 = b - A * X0;
-	P0 = Z0 = B * R0;
-	cout << "..... Running Preconditioned Solver ....." << endl;
-	while ((sqrt(dot(R0, R0)) / sqrt(dot(b, b))) >= EPS) {
+	multiply(A, X, AP);
+	for (size_t i = 0; i < n; ++i) {
+		R[i] = b[i] - AP[i];
+	}
+	{
+		PhaseTimer timer(PHASE_PRECOND);
+		B.apply(R, Z);
+	}
+	P = Z;
+	T rz = dot(R, Z), bb = dot(b, b);
+	rr = dot(R, R);
+	while ((sqrt(rr) / sqrt(bb)) >= tol && itr < iteration_limit) {
 		++itr;
-		T alpha = dot(R0, Z0) / Adot(P0, A, P0);
-		X1 = X0 + alpha * P0;
-		R1 = R0 - alpha * A * P0;
-		Z1 = B * R1;
-		T beta = dot(R1, Z1) / dot(R0, Z0);
-		P1 = Z1 + beta * P0;
-		swap(R0, R1);
-		swap(X0, X1);
-		swap(P0, P1);
-		swap(Z0, Z1);
-		br = b - A * X0;
+		multiply(A, P, AP);
+		T alpha = rz / dot(P, AP);
+		axpy(X, alpha, P);
+		rr = axpy_dot(R, -alpha, AP);
+		record_residual(sqrt(rr) / sqrt(bb));
+		{
+			PhaseTimer timer(PHASE_PRECOND);
+			B.apply(R, Z);
+		}
+		T rz_new = dot(R, Z);
+		T beta = rz_new / rz;
+		xpay(P, beta, Z);
+		rz = rz_new;
 	}
+	return itr;
+}
+
+template <class Precond, class Operator, class T>
+Matrix <T> preconditioned_conjugate_gradient(Precond& B, Operator& A, Matrix <T>& b, long double tol = EPS) {
+	clock_t begin = clock();
+	size_t n = b.getRowSize();
+	Matrix <T> X(n, 1), AP(n, 1);
+	T rr;
+	cout << "..... Running Preconditioned Solver ....." << endl;
+	solver_stats.reset();
+	double wall = MPI_Wtime();
+	int itr = pcg_solve(B, A, b, X, rr, tol);
+	wall = MPI_Wtime() - wall;
 	clock_t end = clock();
 	double elapsed_secs = double(end - begin) / CLOCKS_PER_SEC;
+	T err;
+	{
+		StatsPause pause;
+		multiply(A, X, AP);
+		err = dot(b - AP, b - AP);
+	}
 	cout << "Time Elapsed: " << elapsed_secs << " sec" << endl;
 	cout << "Iterations: " << itr << endl;
-	cout << "Absolute Error: " << dot(b - A * X0, b - A * X0) << endl;
+	cout << "Absolute Error: " << err << endl;
+	report_convergence(sqrt((long double)err) / sqrt((long double)dot(b, b)), tol);
+	finish_report(MPI_COMM_SELF, "pcg", itr, wall, rr);
 	cout << endl;
-	return X0;
-}
\ No newline at end of file
+	return X;
+}
+
+/* assembled COO inverse B ~ A^-1, both converted to CSR and B wrapped as a preconditioner */
+template <class T>
+Matrix <T> preconditioned_conjugate_gradient(Matrix_coo<T>& B, Matrix_coo<T>& A, Matrix <T>& b, long double tol = EPS) {
+	OperatorPreconditioner < Matrix_csr <T> > CB((Matrix_csr <T>(B)));
+	Matrix_csr <T> CA(A);
+	return preconditioned_conjugate_gradient(CB, CA, b, tol);
+}
+
+/*
+	builds the preconditioner called name for the stencil S (A is S in CSR form) and
+	passes it to solve. name is jacobi, bjacobi (one grid line per block), ssor, ic0,
+	gs (multicolor symmetric Gauss-Seidel) or mg (multigrid V-cycle); false for any other
+*/
+template <class T, class Solve>
+bool with_preconditioner(const string& name, const PoissonStencil <T>& S, const Matrix_csr <T>& A, Solve solve) {
+	if (name == "jacobi") {
+		JacobiPreconditioner <T> M(A);
+		solve(M);
+	}
+	else if (name == "bjacobi") {
+		BlockJacobiPreconditioner <T> M(A, S.ny);
+		solve(M);
+	}
+	else if (name == "ssor") {
+		SsorPreconditioner <T> M(A);
+		solve(M);
+	}
+	else if (name == "ic0") {
+		IncompleteCholeskyPreconditioner <T> M(A);
+		solve(M);
+	}
+	else if (name == "gs") {
+		MulticolorGaussSeidelPreconditioner <T> M(A);
+		solve(M);
+	}
+	else if (name == "mg") {
+		MultigridPreconditioner <T> M(S);
+		solve(M);
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+/* serial PCG with the preconditioner c.precond, the products by the stencil or its CSR form */
+template <class T>
+void run_preconditioned_solver(const SolverConfig& c) {
+	auto t = generate_sparse_matrix<T>(c.nx, c.ny, c.seed);
+	Matrix_csr <T> A = to_csr(t.second);
+	auto solve = [&](auto& M) {
+		if (c.op == "csr") preconditioned_conjugate_gradient(M, A, t.first, c.tol);
+		else preconditioned_conjugate_gradient(M, t.second, t.first, c.tol);
+	};
+	if (!with_preconditioner(c.precond, t.second, A, solve)) {
+		cout << "Unknown preconditioner: " << c.precond << endl;
+	}
+}
+
+/* block CG against c.rhs random right-hand sides */
+template <class T>
+void run_block_solver(const SolverConfig& c) {
+	auto t = generate_sparse_matrix<T>(c.nx, c.ny, c.seed);
+	Matrix <T> B(t.first.getRowSize(), c.rhs);
+	fill_random(B, c.seed);
+	if (c.op == "csr") {
+		Matrix_csr <T> A = to_csr(t.second);
+		block_conjugate_gradient(A, B, c.tol);
+	}
+	else {
+		block_conjugate_gradient(t.second, B, c.tol);
+	}
+}
+
+/*
+	serial CG on the master with the stencil or its CSR form as the operator;
+	mixed precision refinement with Low inner solves when Low is not T, and
+	steps > 1 runs the recycled sequence of time_steps instead
+*/
+template <class T, class Low>
+void run_serial_solver(const SolverConfig& c) {
+	auto t = generate_sparse_matrix<T>(c.nx, c.ny, c.seed);
+	auto solve = [&](auto& A) {
+		if (std::is_same<T, Low>::value && c.steps > 1) time_steps(A, t.first, c.steps, c.tol);
+		else if (std::is_same<T, Low>::value) conjugate_gradient(A, t.first, c.tol);
+		else mixed_precision_conjugate_gradient<Low>(A, t.first, c.tol);
+	};
+	if (c.op == "csr") {
+		Matrix_csr <T> A = to_csr(t.second);
+		solve(A);
+	}
+	else {
+		solve(t.second);
+	}
+}